@@ -189,7 +189,7 @@ Separate_MAC_Check<T>::Separate_MAC_Check(const T& ai, Names& Nms,
 template<class T>
 void Separate_MAC_Check<T>::Check(const Player& P)
 {
-  P.my_num();
+  check_player.follow_traffic(P);
   MAC_Check<T>::Check(check_player);
 }
 
@@ -244,6 +244,10 @@ void Parallel_MAC_Check<T>::POpen_Begin(vector<T>& values,
   values.size();
   this->AddToMacs(S);
 
+  send_player.follow_traffic(P);
+  for (auto summer : summers)
+    summer->follow_traffic(P);
+
   int my_relative_num = positive_modulo(P.my_num() - send_base_player, P.num_players());
   int sum_players = (P.num_players() - 2 + this->opening_sum) / this->opening_sum;
   int receiver = positive_modulo(send_base_player + my_relative_num % sum_players, P.num_players());
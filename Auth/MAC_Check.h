@@ -134,7 +134,7 @@ class Parallel_MAC_Check: public Separate_MAC_Check<T>
 
   int send_base_player;
 
-  WaitQueue< vector<T> > value_queue;
+  SpscQueue< vector<T> > value_queue;
 
 public:
   Parallel_MAC_Check(const T& ai, Names& Nms, int thread_num, int opening_sum=10, int max_broadcast=10, int send_player=0);
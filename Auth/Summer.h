@@ -9,7 +9,7 @@
 #define OFFLINE_SUMMER_H_
 
 #include "Networking/Player.h"
-#include "Tools/WaitQueue.h"
+#include "Tools/SpscQueue.h"
 #include "Tools/time-func.h"
 
 #include <pthread.h>
@@ -33,15 +33,16 @@ public:
     vector<T> values;
 
     pthread_t thread;
-    WaitQueue<int> input_queue, output_queue;
+    SpscQueue<int> input_queue, output_queue;
     bool stop;
     int size;
-    WaitQueue< vector<T> > share_queue;
+    SpscQueue< vector<T> > share_queue;
 
     Summer(int sum_players, int last_sum_players, int next_sum_players,
             Player* send_player, Player* receive_player, Parallel_MAC_Check<T>& MC);
     ~Summer();
     void run();
+    void follow_traffic(const Player& P) { send_player->follow_traffic(P); }
 };
 
 #endif /* OFFLINE_SUMMER_H_ */
@@ -40,6 +40,7 @@
 #include "Math/gf2n.h"
 #include "Networking/sockets.h"
 #include "Networking/STS.h"
+#include "Networking/SequenceCipher.h"
 #include "Tools/int.h"
 #include "Math/Setup.h"
 #include "Auth/fake-stuff.h"
@@ -49,6 +50,7 @@
 #include <iomanip>
 #include <sstream>
 #include <fstream>
+#include <memory>
 
 typedef pair< vector<octet>, vector<octet> > keypair_t; // A pair of send/recv keys for talking to SPDZ
 typedef vector< keypair_t > commsec_t;  // A database of send/recv keys indexed by server
@@ -154,7 +156,7 @@ void send_private_inputs(vector<gfp>& values, vector<int>& sockets, int nparties
     {
         os.reset_write_head();
         os.Receive(sockets[j]);
-        os.decrypt_sequence(&commsec[j].second[0],0);
+        unique_ptr<SequenceCipher>(SequenceCipher::create(commsec[j].second))->decrypt(os, 0);
         os.decrypt(keys[j]);
 
         for (int j = 0; j < num_inputs; j++)
@@ -183,8 +185,10 @@ void send_private_inputs(vector<gfp>& values, vector<int>& sockets, int nparties
         y.pack(os);
     }
     for (int j = 0; j < nparties; j++) {
-        os.encrypt_sequence(&commsec[j].first[0],0);
-        os.Send(sockets[j]);
+        // encrypt a copy, the ciphertext differs per engine
+        octetStream cs = os;
+        unique_ptr<SequenceCipher>(SequenceCipher::create(commsec[j].first))->encrypt(cs, 0);
+        cs.Send(sockets[j]);
     }
 }
 
@@ -311,7 +315,7 @@ gfp receive_result(vector<int>& sockets, int nparties, commsec_t commsec, vector
         os.reset_write_head();
         os.Receive(sockets[i]);
 
-        os.decrypt_sequence(&commsec[i].second[0],1);
+        unique_ptr<SequenceCipher>(SequenceCipher::create(commsec[i].second))->decrypt(os, 1);
         os.decrypt(keys[i]);
 
         for (unsigned int j = 0; j < 3; j++)
@@ -344,7 +348,8 @@ int main(int argc, char** argv)
     if (argc < 5) {
         cout << "Usage is external-client <client identifier> <number of spdz parties> "
            << "<salary to compare> <finish (0 false, 1 true)> <optional host name, default localhost> "
-           << "<optional spdz party port base number, default 14000>" << endl;
+           << "<optional spdz party port base number, default 14000> "
+           << "<optional cipher, secretbox or aes-gcm as with --commsec-cipher, default secretbox>" << endl;
         exit(0);
     }
 
@@ -356,6 +361,8 @@ int main(int argc, char** argv)
         host_name = argv[5];
     if (argc > 6)
         port_base = atoi(argv[6]);
+    if (argc > 7)
+        SequenceCipher::default_type = SequenceCipher::parse_type(argv[7]);
 
     sts_key.server_publickey.resize(nparties);
     for(int i = 0 ; i < nparties; i++) {
@@ -10,6 +10,9 @@
 #include "Reshare.h"
 #include "DistDecrypt.h"
 #include "Tools/mkpath.h"
+#include "Tools/ShmPipe.h"
+
+#include <unistd.h>
 
 template<class FD>
 Producer<FD>::Producer(int output_thread, bool write_output) :
@@ -237,6 +240,21 @@ string open_prep_file(ofstream& outf, string data_type, int my_num, int thread_n
     if (mkdir_p(dir.c_str()) == -1)
         throw runtime_error("cannot create directory " + dir);
     string file = prep_filename<T>(data_type, my_num, thread_num, initial, dir);
+    // a compact file (Data_Files::PACKED_SUFFIX) would take precedence
+    unlink((file + ".packed").c_str());
+    // verified data can go straight to a co-located online phase
+    if (ShmPipeBuf::enabled and not initial)
+    {
+        // the online phase continues in the file after the pipe,
+        // so it must only contain what is written from now on
+        if (clear)
+        {
+            ofstream tmp(file.c_str(), ios::out | ios::binary | ios::trunc);
+            if (tmp.fail()) { throw file_error(file); }
+        }
+        ShmPipeBuf::redirect(outf, file);
+        return file;
+    }
     outf.open(file.c_str(),ios::out | ios::binary | (clear ? ios::trunc : ios::app));
     if (outf.fail()) { throw file_error(file); }
     return file;
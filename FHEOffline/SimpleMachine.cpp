@@ -14,6 +14,7 @@
 #include "Tools/ezOptionParser.h"
 #include "Auth/MAC_Check.h"
 #include "Auth/fake-stuff.h"
+#include "Tools/int.h"
 
 void* run_generator(void* generator)
 {
@@ -31,6 +32,7 @@ MachineBase::MachineBase() :
 MachineBase::MachineBase(int argc, const char** argv) : MachineBase()
 {
     parse_options(argc, argv);
+    read_plan();
     mult_performance();
 }
 
@@ -81,12 +83,43 @@ void MachineBase::parse_options(int argc, const char** argv)
           "-2", // Flag token.
           "--gf2n" // Flag token.
     );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Produce the amount in a plan written by Player-Online.x --plan instead of -n", // Help description.
+          "-pl", // Flag token.
+          "--plan" // Flag token.
+    );
+    opt.add(
+          "1", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Connections per pair of players for large messages, the same for all players (default: 1)", // Help description.
+          "-st", // Flag token.
+          "--stripes" // Flag token.
+    );
+    opt.add(
+          "1048576", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Split messages of at least this many bytes over the connections given by --stripes (default: 1048576)", // Help description.
+          "-stt", // Flag token.
+          "--stripe-threshold" // Flag token.
+    );
 
     OfflineMachineBase::parse_options(argc, argv);
     opt.get("-h")->getString(hostname);
     opt.get("-pn")->getInt(portnum_base);
     opt.get("-s")->getInt(sec);
     opt.get("-f")->getInt(field_size);
+    int stripe_threshold;
+    opt.get("--stripes")->getInt(Stripes::count);
+    opt.get("--stripe-threshold")->getInt(stripe_threshold);
+    Stripes::threshold = stripe_threshold;
     use_gf2n = opt.isSet("-2");
     if (use_gf2n)
     {
@@ -144,9 +177,39 @@ void MultiplicativeMachine::parse_options(int argc, const char** argv)
     else
         data_type = DATA_TRIPLE;
     produce_inputs = opt.isSet("--inputs");
+    read_plan();
     cout << "Going to produce " << item_type() << endl;
 }
 
+void MachineBase::read_plan()
+{
+    if (not opt.isSet("--plan"))
+        return;
+    string filename;
+    opt.get("--plan")->getString(filename);
+    ifstream plan(filename);
+    if (plan.fail())
+        throw file_error(filename);
+    string field = use_gf2n ? "gf2n" : "gfp";
+    string type = Data_Files::dtype_names[data_type];
+    long long needed = 0;
+    string line;
+    while (getline(plan, line))
+    {
+        stringstream ss(line);
+        string f, t;
+        long long n;
+        if (line[0] == '#' or not (ss >> f >> t >> n) or f != field)
+            continue;
+        if (produce_inputs ? t.find("Inputs-") == 0 : t == type)
+            needed = max(needed, n);
+    }
+    ntriples = needed;
+    nTriplesPerThread = DIV_CEIL(ntriples, nthreads);
+    cout << "Plan " << filename << " needs " << ntriples << " " << field
+            << " " << item_type() << endl;
+}
+
 string MachineBase::item_type()
 {
     string res;
@@ -36,6 +36,8 @@ public:
     void run();
 
     void parse_options(int argc, const char** argv);
+    // set the number of items from a plan if given
+    void read_plan();
 
     string item_type();
 
@@ -16,6 +16,7 @@
 
 #include <sstream>
 #include <fstream>
+#include <unistd.h>
 using namespace std;
 
 
@@ -398,6 +399,15 @@ int main(int argc, const char** argv)
         "-z", // Flag token.
         "--zero" // Flag token.
   );
+  opt.add(
+        "", // Default.
+        0, // Required?
+        0, // Number of args expected.
+        0, // Delimiter if expecting multiple args.
+        "Store field elements in as few bytes as possible", // Help description.
+        "-pk", // Flag token.
+        "--packed" // Flag token.
+  );
   opt.parse(argc, argv);
 
   vector<string> badOptions;
@@ -552,4 +562,24 @@ int main(int argc, const char** argv)
   make_bit_triples(key2,nplayers,nbitgf2ntrip,DATA_BITGF2NTRIPLE,zero);
   make_PreMulC(key2,nplayers,ninv,zero);
   make_PreMulC(keyp,nplayers,ninv,zero);
+
+  // files of the other format would take precedence or be stale
+  bool packed = opt.isSet("--packed");
+  for (int field_type = 0; field_type < N_DATA_FIELD_TYPE; field_type++)
+    for (int i = 0; i < nplayers; i++)
+      {
+        vector<string> filenames;
+        for (int dtype = 0; dtype < N_DTYPE; dtype++)
+          if (Data_Files::implemented[field_type][dtype])
+            filenames.push_back(Data_Files::get_filename(prep_data_prefix,
+                field_type, dtype, i));
+        for (int j = 0; j < nplayers; j++)
+          filenames.push_back(Data_Files::get_input_filename(prep_data_prefix,
+              field_type, i, j));
+        for (auto& filename : filenames)
+          if (packed)
+            Data_Files::pack_file(filename, field_type);
+          else
+            unlink((filename + Data_Files::PACKED_SUFFIX).c_str());
+      }
 }
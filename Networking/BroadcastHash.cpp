@@ -0,0 +1,165 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * BroadcastHash.cpp
+ *
+ */
+
+#include "Networking/BroadcastHash.h"
+
+#include <stdlib.h>
+#include <stdexcept>
+
+BroadcastHash::Type BroadcastHash::default_type = BLAKE2B_HASH;
+bool BroadcastHash::use_thread = false;
+
+BroadcastHash::Type BroadcastHash::parse_type(const string& name)
+{
+    if (name == "sha1")
+        return SHA1_HASH;
+    else if (name == "blake2b")
+        return BLAKE2B_HASH;
+    else
+        throw runtime_error("unknown broadcast hash: " + name);
+}
+
+BroadcastHash* BroadcastHash::create()
+{
+    BroadcastHash* hash;
+    switch (default_type)
+    {
+    case SHA1_HASH:
+        hash = new Sha1BroadcastHash;
+        break;
+    case BLAKE2B_HASH:
+        hash = new Blake2bBroadcastHash;
+        break;
+    default:
+        throw runtime_error("invalid broadcast hash");
+    }
+    return new ChunkedBroadcastHash(hash, use_thread);
+}
+
+void Sha1BroadcastHash::update(const octet* data, size_t length)
+{
+    blk_SHA1_Update(&ctx, data, length);
+}
+
+void Sha1BroadcastHash::final(octetStream& digest)
+{
+    octet hashVal[HASH_SIZE];
+    blk_SHA1_Final(hashVal, &ctx);
+    digest.append(hashVal, HASH_SIZE);
+    blk_SHA1_Init(&ctx);
+}
+
+Blake2bBroadcastHash::Blake2bBroadcastHash()
+{
+    if (posix_memalign((void**)&state, 64, sizeof(*state)) != 0)
+        throw bad_alloc();
+    crypto_generichash_init(state, 0, 0, crypto_generichash_BYTES);
+}
+
+Blake2bBroadcastHash::~Blake2bBroadcastHash()
+{
+    free(state);
+}
+
+void Blake2bBroadcastHash::update(const octet* data, size_t length)
+{
+    crypto_generichash_update(state, data, length);
+}
+
+void Blake2bBroadcastHash::final(octetStream& digest)
+{
+    octet hashVal[crypto_generichash_BYTES];
+    crypto_generichash_final(state, hashVal, crypto_generichash_BYTES);
+    digest.append(hashVal, crypto_generichash_BYTES);
+    crypto_generichash_init(state, 0, 0, crypto_generichash_BYTES);
+}
+
+ChunkedBroadcastHash::ChunkedBroadcastHash(BroadcastHash* hash,
+        bool use_thread) :
+        hash(hash), current(new vector<octet>), use_thread(use_thread),
+        thread(0)
+{
+    current->reserve(CHUNK_SIZE);
+    if (use_thread)
+        pthread_create(&thread, 0, run_thread, this);
+}
+
+ChunkedBroadcastHash::~ChunkedBroadcastHash()
+{
+    if (use_thread)
+    {
+        // hash what is left to free the chunks
+        bool tmp;
+        jobs.push(0);
+        done.pop(tmp);
+        jobs.stop();
+        pthread_join(thread, 0);
+    }
+    delete current;
+    delete hash;
+}
+
+void* ChunkedBroadcastHash::run_thread(void* hash)
+{
+    ChunkedBroadcastHash& self = *(ChunkedBroadcastHash*)hash;
+    vector<octet>* chunk = 0;
+    while (self.jobs.pop(chunk))
+    {
+        if (chunk)
+        {
+            self.hash->update(chunk->data(), chunk->size());
+            delete chunk;
+        }
+        else
+            self.done.push(true);
+    }
+    return 0;
+}
+
+void ChunkedBroadcastHash::flush()
+{
+    if (current->empty())
+        return;
+    if (use_thread)
+    {
+        jobs.push(current);
+        current = new vector<octet>;
+        current->reserve(CHUNK_SIZE);
+    }
+    else
+    {
+        hash->update(current->data(), current->size());
+        current->clear();
+    }
+}
+
+void ChunkedBroadcastHash::update(const octet* data, size_t length)
+{
+    // large messages are worth hashing on their own
+    if (not use_thread and length >= CHUNK_SIZE)
+    {
+        flush();
+        hash->update(data, length);
+        return;
+    }
+    // the caller may reuse the data, so the thread needs a copy
+    current->insert(current->end(), data, data + length);
+    if (current->size() >= CHUNK_SIZE)
+        flush();
+}
+
+void ChunkedBroadcastHash::final(octetStream& digest)
+{
+    flush();
+    if (use_thread)
+    {
+        bool tmp;
+        jobs.push(0);
+        done.pop(tmp);
+    }
+    hash->final(digest);
+}
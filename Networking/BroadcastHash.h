@@ -0,0 +1,102 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * BroadcastHash.h
+ *
+ */
+
+#ifndef NETWORKING_BROADCASTHASH_H_
+#define NETWORKING_BROADCASTHASH_H_
+
+#include "Tools/octetStream.h"
+#include "Tools/sha1.h"
+#include "Tools/WaitQueue.h"
+
+#include <sodium.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*
+ * Running hash over all broadcast data since the last check.
+ * All parties must use the same primitive, but chunking and
+ * the helper thread are local choices.
+ */
+class BroadcastHash
+{
+public:
+    enum Type
+    {
+        SHA1_HASH, BLAKE2B_HASH
+    };
+
+    static Type default_type;
+    // Hash in a helper thread
+    static bool use_thread;
+
+    static Type parse_type(const string& name);
+    // New instance with the default settings
+    static BroadcastHash* create();
+
+    virtual ~BroadcastHash() {}
+
+    virtual void update(const octet* data, size_t length) = 0;
+    void update(const octetStream& os) { update(os.get_data(), os.get_length()); }
+    // Digest of everything since the last call, resets the state
+    virtual void final(octetStream& digest) = 0;
+};
+
+class Sha1BroadcastHash : public BroadcastHash
+{
+    blk_SHA_CTX ctx;
+
+public:
+    Sha1BroadcastHash() { blk_SHA1_Init(&ctx); }
+    void update(const octet* data, size_t length);
+    void final(octetStream& digest);
+};
+
+// BLAKE2b as provided by libsodium
+class Blake2bBroadcastHash : public BroadcastHash
+{
+    // needs more alignment than new guarantees
+    crypto_generichash_state* state;
+
+public:
+    Blake2bBroadcastHash();
+    ~Blake2bBroadcastHash();
+    void update(const octet* data, size_t length);
+    void final(octetStream& digest);
+};
+
+/*
+ * Collects small messages into large chunks before hashing,
+ * optionally in a helper thread. The digest is the same as
+ * for the underlying hash.
+ */
+class ChunkedBroadcastHash : public BroadcastHash
+{
+    static const size_t CHUNK_SIZE = 1 << 16;
+
+    BroadcastHash* hash;
+    vector<octet>* current;
+    bool use_thread;
+    // chunks to hash, 0 to request a notification when done
+    WaitQueue<vector<octet>*> jobs;
+    WaitQueue<bool> done;
+    pthread_t thread;
+
+    static void* run_thread(void* hash);
+    void flush();
+
+public:
+    // Takes ownership of hash
+    ChunkedBroadcastHash(BroadcastHash* hash, bool use_thread);
+    ~ChunkedBroadcastHash();
+
+    void update(const octet* data, size_t length);
+    void final(octetStream& digest);
+};
+
+#endif /* NETWORKING_BROADCASTHASH_H_ */
@@ -0,0 +1,269 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * ChannelPlayer.cpp
+ *
+ */
+
+#include "Networking/ChannelPlayer.h"
+#include "Exceptions/Exceptions.h"
+#include "Tools/int.h"
+
+#define FRAME_HEADER_SIZE 12
+
+mutex ChannelMesh::global_lock;
+ChannelMesh* ChannelMesh::singleton = 0;
+
+bool ChannelPlayer::enabled = false;
+
+// false on end of file
+static bool receive_fully(int socket, octet* buffer, size_t length)
+{
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t res = recv(socket, buffer + done, length - done, MSG_WAITALL);
+        if (res == 0)
+            return false;
+        if (res < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            error("Receiving error - 3");
+        }
+        done += res;
+    }
+    return true;
+}
+
+ChannelMesh::Channel::Channel() :
+        credit(WINDOW), unreturned(0)
+{
+}
+
+ChannelMesh::Channel::~Channel()
+{
+    for (auto os : queue)
+        delete os;
+}
+
+ChannelMesh* ChannelMesh::acquire(const Names& Nms)
+{
+    lock_guard<mutex> lock(global_lock);
+    if (singleton == 0)
+        singleton = new ChannelMesh(Nms);
+    singleton->users++;
+    return singleton;
+}
+
+void ChannelMesh::release()
+{
+    lock_guard<mutex> lock(global_lock);
+    if (--singleton->users == 0)
+    {
+        delete singleton;
+        singleton = 0;
+    }
+}
+
+ChannelMesh::ChannelMesh(const Names& Nms) :
+        users(0)
+{
+    player = new Player(Nms, MESH_ID);
+    int n = player->num_players();
+    connections.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        connections[i] = new Connection;
+        if (i == player->my_num())
+            continue;
+        connections[i]->socket = player->socket(i);
+        // idle channels are normal
+        struct timeval tv = { 0, 0 };
+        if (setsockopt(connections[i]->socket, SOL_SOCKET, SO_RCVTIMEO,
+                (char*) &tv, sizeof(tv)) < 0)
+            error("ChannelMesh:setsockopt");
+        pair<ChannelMesh*, int>* arg = new pair<ChannelMesh*, int>(this, i);
+        pthread_create(&connections[i]->thread, 0, run_thread, arg);
+    }
+    cerr << "Set up connections shared by all channels" << endl;
+}
+
+ChannelMesh::~ChannelMesh()
+{
+    // the threads stop when the other sides have shut down as well
+    for (auto c : connections)
+        if (c->thread)
+            shutdown(c->socket, SHUT_WR);
+    for (auto c : connections)
+    {
+        if (c->thread)
+            pthread_join(c->thread, 0);
+        delete c;
+    }
+    delete player;
+}
+
+void* ChannelMesh::run_thread(void* arg)
+{
+    pair<ChannelMesh*, int>* mesh_peer = (pair<ChannelMesh*, int>*) arg;
+    mesh_peer->first->run(mesh_peer->second);
+    delete mesh_peer;
+    return 0;
+}
+
+void ChannelMesh::run(int peer)
+{
+    Connection& c = *connections[peer];
+    octet header[FRAME_HEADER_SIZE];
+    while (receive_fully(c.socket, header, FRAME_HEADER_SIZE))
+    {
+        uint32_t channel = decode_length(header, 4);
+        uint64_t length = decode_length(header + 4, 8);
+        if (channel & CREDIT_FLAG)
+        {
+            lock_guard<mutex> lock(c.lock);
+            c.channels[channel & ~CREDIT_FLAG].credit += length;
+            c.cv.notify_all();
+            continue;
+        }
+
+        octetStream* os = new octetStream(length);
+        if (not receive_fully(c.socket, os->append(length), length))
+        {
+            delete os;
+            break;
+        }
+        lock_guard<mutex> lock(c.lock);
+        c.channels[channel].queue.push_back(os);
+        c.cv.notify_all();
+    }
+
+    lock_guard<mutex> lock(c.lock);
+    c.closed = true;
+    c.cv.notify_all();
+}
+
+void ChannelMesh::write_frame(Connection& c, uint32_t channel,
+        const octetStream* o, uint64_t length)
+{
+    octet header[FRAME_HEADER_SIZE];
+    encode_length(header, channel, 4);
+    encode_length(header + 4, length, 8);
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = FRAME_HEADER_SIZE;
+    int n = 1;
+    if (o and length)
+    {
+        iov[1].iov_base = o->get_data();
+        iov[1].iov_len = length;
+        n++;
+    }
+    lock_guard<mutex> lock(c.write_lock);
+    ::send(c.socket, iov, n);
+}
+
+void ChannelMesh::send(int player, int channel, const octetStream& o)
+{
+    Connection& c = *connections.at(player);
+    if (player == this->player->my_num())
+    {
+        lock_guard<mutex> lock(c.lock);
+        c.channels[channel].queue.push_back(new octetStream(o));
+        c.cv.notify_all();
+        return;
+    }
+
+    {
+        unique_lock<mutex> lock(c.lock);
+        Channel& ch = c.channels[channel];
+        // a message can exceed the window as long as there is credit left
+        while (ch.credit <= 0 and not c.closed)
+            c.cv.wait(lock);
+        if (c.closed)
+            throw runtime_error("connection to player " + to_string(player)
+                    + " closed");
+        ch.credit -= o.get_length();
+    }
+    write_frame(c, channel, &o, o.get_length());
+}
+
+void ChannelMesh::receive(int player, int channel, octetStream& o)
+{
+    Connection& c = *connections.at(player);
+    octetStream* os;
+    long long credit = 0;
+    {
+        unique_lock<mutex> lock(c.lock);
+        Channel& ch = c.channels[channel];
+        while (ch.queue.empty() and not c.closed)
+            c.cv.wait(lock);
+        if (ch.queue.empty())
+            throw runtime_error("connection to player " + to_string(player)
+                    + " closed");
+        os = ch.queue.front();
+        ch.queue.pop_front();
+        if (player != this->player->my_num())
+        {
+            // return credit in batches
+            ch.unreturned += os->get_length();
+            if (ch.unreturned >= WINDOW / 4)
+            {
+                credit = ch.unreturned;
+                ch.unreturned = 0;
+            }
+        }
+    }
+    o.swap(*os);
+    delete os;
+    if (credit)
+        write_frame(c, channel | CREDIT_FLAG, 0, credit);
+}
+
+ChannelPlayer::ChannelPlayer(const Names& Nms, int id_base) :
+        Player(Nms, id_base, false), channel(id_base)
+{
+    if (channel & ChannelMesh::CREDIT_FLAG)
+        throw runtime_error("invalid channel id");
+    mesh = ChannelMesh::acquire(Nms);
+}
+
+ChannelPlayer::~ChannelPlayer()
+{
+    ChannelMesh::release();
+}
+
+void ChannelPlayer::send_message(int player, const octetStream& o) const
+{
+    mesh->send(player, channel, o);
+}
+
+void ChannelPlayer::receive_message(int player, octetStream& o) const
+{
+    mesh->receive(player, channel, o);
+}
+
+// incoming messages are queued in the background,
+// so receiving after sending cannot block the other side
+void ChannelPlayer::transfer(const vector<const octetStream*>& sends,
+        const vector<octetStream*>& receives) const
+{
+    for (int i = 0; i < nplayers; i++)
+        if (sends[i])
+            mesh->send(i, channel, *sends[i]);
+    for (int i = 0; i < nplayers; i++)
+        if (receives[i])
+            mesh->receive(i, channel, *receives[i]);
+}
+
+void ChannelPlayer::exchange(int other, octetStream& o) const
+{
+    send_receive(other, other, o);
+}
+
+void ChannelPlayer::pass_around(octetStream& o, int offset) const
+{
+    send_receive(positive_modulo(player_no + offset, nplayers),
+            positive_modulo(player_no - offset, nplayers), o);
+}
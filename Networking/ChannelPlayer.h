@@ -0,0 +1,113 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * ChannelPlayer.h
+ *
+ */
+
+#ifndef NETWORKING_CHANNELPLAYER_H_
+#define NETWORKING_CHANNELPLAYER_H_
+
+#include "Networking/Player.h"
+
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+/*
+ * One TCP connection per pair of processes, shared by all channels.
+ * Frames consist of a channel id, a length and the data. A thread per
+ * peer sorts incoming frames into per-channel queues.
+ * Flow control is per channel: a sender may only start a message while
+ * the receiver has less than WINDOW bytes of it that are not consumed
+ * yet, and the receiver returns credit in frames with CREDIT_FLAG set.
+ */
+class ChannelMesh
+{
+    struct Channel
+    {
+        deque<octetStream*> queue;
+        // sending side
+        long long credit;
+        // receiving side, consumed but not returned to the sender
+        long long unreturned;
+
+        Channel();
+        ~Channel();
+    };
+
+    struct Connection
+    {
+        int socket;
+        mutex lock;
+        condition_variable cv;
+        map<int, Channel> channels;
+        bool closed;
+        mutex write_lock;
+        pthread_t thread;
+
+        Connection() : socket(-1), closed(false), thread(0) {}
+    };
+
+    static mutex global_lock;
+    static ChannelMesh* singleton;
+
+    // owns the sockets
+    Player* player;
+    vector<Connection*> connections;
+    int users;
+
+    ChannelMesh(const Names& Nms);
+    ~ChannelMesh();
+
+    void write_frame(Connection& c, uint32_t channel, const octetStream* o,
+            uint64_t length);
+    static void* run_thread(void* arg);
+    void run(int peer);
+
+public:
+    static const long long WINDOW = 1 << 24;
+    static const uint32_t CREDIT_FLAG = 1u << 31;
+    // connection id outside the range of Player instances
+    static const int MESH_ID = 7 << 28;
+
+    // Set up on first use, shared afterwards
+    static ChannelMesh* acquire(const Names& Nms);
+    // Shut down after the last user in all processes
+    static void release();
+
+    void send(int player, int channel, const octetStream& o);
+    // Blocks until a message is available
+    void receive(int player, int channel, octetStream& o);
+};
+
+/*
+ * Player using a channel of the shared mesh, identified by the
+ * same id as the connections it replaces.
+ */
+class ChannelPlayer : public Player
+{
+    ChannelMesh* mesh;
+    int channel;
+
+protected:
+    void send_message(int player, const octetStream& o) const;
+    void receive_message(int player, octetStream& o) const;
+    void transfer(const vector<const octetStream*>& sends,
+        const vector<octetStream*>& receives) const;
+
+public:
+    // Use for online threads (-ch)
+    static bool enabled;
+
+    ChannelPlayer(const Names& Nms, int id_base = 0);
+    ~ChannelPlayer();
+
+    void exchange(int other, octetStream& o) const;
+    void pass_around(octetStream& o, int offset = 1) const;
+};
+
+#endif /* NETWORKING_CHANNELPLAYER_H_ */
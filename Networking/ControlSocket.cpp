@@ -0,0 +1,94 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * ControlSocket.cpp
+ *
+ */
+
+#include "ControlSocket.h"
+#include "Networking/sockets.h"
+
+#include <sys/un.h>
+
+ControlSocket::ControlSocket(const string& path) :
+        path(path), client_socket(-1)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        throw runtime_error("control socket path too long: " + path);
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    main_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (main_socket < 0)
+        error("ControlSocket:socket");
+    unlink(path.c_str());
+    if (::bind(main_socket, (sockaddr*)&address, sizeof(address)) != 0)
+        error("ControlSocket:bind");
+    if (listen(main_socket, 1) != 0)
+        error("ControlSocket:listen");
+    cerr << "Waiting for requests on " << path << endl;
+}
+
+ControlSocket::~ControlSocket()
+{
+    if (client_socket >= 0)
+        close(client_socket);
+    close(main_socket);
+    unlink(path.c_str());
+}
+
+bool ControlSocket::get_request(string& request)
+{
+    while (true)
+    {
+        size_t end = buffer.find('\n');
+        if (end != string::npos)
+        {
+            request = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            if (request.size() and request[request.size() - 1] == '\r')
+                request.resize(request.size() - 1);
+            if (request.size())
+                return true;
+            continue;
+        }
+
+        if (client_socket < 0)
+        {
+            client_socket = accept(main_socket, 0, 0);
+            if (client_socket < 0)
+                error("ControlSocket:accept");
+            buffer.clear();
+        }
+
+        char tmp[4096];
+        int n = recv(client_socket, tmp, sizeof(tmp), 0);
+        if (n > 0)
+            buffer.append(tmp, n);
+        else
+        {
+            // wait for next client
+            close(client_socket);
+            client_socket = -1;
+        }
+    }
+}
+
+void ControlSocket::reply(const string& message)
+{
+    if (client_socket < 0)
+        return;
+    string line = message + "\n";
+    size_t sent = 0;
+    while (sent < line.size())
+    {
+        // the client might have gone away already
+        int n = ::send(client_socket, line.c_str() + sent, line.size() - sent,
+                MSG_NOSIGNAL);
+        if (n < 0 and errno != EINTR)
+            break;
+        sent += max(n, 0);
+    }
+}
@@ -0,0 +1,36 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * ControlSocket.h
+ *
+ */
+
+#ifndef NETWORKING_CONTROLSOCKET_H_
+#define NETWORKING_CONTROLSOCKET_H_
+
+#include <string>
+using namespace std;
+
+/* Local (UNIX domain) socket accepting one request per line
+ * and sending one reply per line, serving one client at a time
+ */
+class ControlSocket
+{
+    string path;
+    int main_socket;
+    int client_socket;
+    string buffer;
+
+    // prevent copying
+    ControlSocket(const ControlSocket& other);
+
+public:
+    ControlSocket(const string& path);
+    ~ControlSocket();
+
+    // returns false if there is no further request
+    bool get_request(string& request);
+    void reply(const string& message);
+};
+
+#endif /* NETWORKING_CONTROLSOCKET_H_ */
@@ -0,0 +1,172 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * EmulatedPlayer.cpp
+ *
+ */
+
+#include "Networking/EmulatedPlayer.h"
+#include "Networking/ShmPlayer.h"
+#include "Exceptions/Exceptions.h"
+#include "Tools/int.h"
+
+#include <time.h>
+#include <fstream>
+#include <sstream>
+
+string NetworkEmulation::filename;
+
+vector<LinkEmulation> NetworkEmulation::read_links(const string& filename,
+        int from, int nplayers)
+{
+    ifstream file(filename.c_str());
+    if (file.fail())
+        throw file_error("cannot open " + filename
+                + ". See NETWORK.example for an example.");
+    vector<LinkEmulation> res(nplayers);
+    string line;
+    while (getline(file, line))
+    {
+        if (line.empty() or line[0] == '#')
+            continue;
+        stringstream ss(line);
+        string source, dest;
+        LinkEmulation link;
+        ss >> source >> dest >> link.latency >> link.bandwidth;
+        if (ss.fail())
+            throw file_error("cannot parse '" + line + "' in " + filename);
+        ss >> link.jitter;
+        if (source != "*" and atoi(source.c_str()) != from)
+            continue;
+        for (int i = 0; i < nplayers; i++)
+            if (i != from and (dest == "*" or atoi(dest.c_str()) == i))
+                res[i] = link;
+    }
+    return res;
+}
+
+static uint64_t now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+template<class T>
+EmulatedPlayer<T>::EmulatedPlayer(const Names& Nms, int id_base) :
+        T(Nms, id_base), link_free(Nms.num_players()),
+        last_arrival(Nms.num_players()),
+        jitter_engine(Nms.my_num() + 1 + id_base)
+{
+    links = NetworkEmulation::read_links(NetworkEmulation::filename,
+            this->my_num(), this->num_players());
+}
+
+template<class T>
+EmulatedPlayer<T>::~EmulatedPlayer()
+{
+    if (waiting.elapsed() > 0)
+        cerr << "Emulated network delay: " << waiting.elapsed() << " seconds"
+                << endl;
+}
+
+template<class T>
+uint64_t EmulatedPlayer<T>::arrival(int player, size_t length) const
+{
+    const LinkEmulation& link = links[player];
+    uint64_t start = max(now(), link_free[player]);
+    uint64_t end = start;
+    if (link.bandwidth > 0)
+        end += 8e3 * length / link.bandwidth;
+    link_free[player] = end;
+    double delay = link.latency;
+    if (link.jitter > 0)
+        delay += uniform_real_distribution<double>(0, link.jitter)(jitter_engine);
+    uint64_t res = max(end + uint64_t(delay * 1e6), last_arrival[player]);
+    last_arrival[player] = res;
+    return res;
+}
+
+// the arrival time goes at the end so that the receiver can remove it
+// without moving the data
+template<class T>
+void EmulatedPlayer<T>::stamp(octetStream& stamped, const octetStream& o,
+        int player) const
+{
+    stamped.resize_precise(o.get_length() + 8);
+    stamped.append(o.get_data(), o.get_length());
+    encode_length(stamped.append(8), arrival(player, o.get_length()), 8);
+}
+
+template<class T>
+uint64_t EmulatedPlayer<T>::unstamp(octetStream& o) const
+{
+    if (o.get_length() < 8)
+        throw runtime_error("message without arrival time, "
+                "do all players emulate the network?");
+    o.rewind_write_head(8);
+    return decode_length(o.get_data() + o.get_length(), 8);
+}
+
+static void wait_until(uint64_t time, Timer& timer)
+{
+    if (now() >= time)
+        return;
+    struct timespec ts;
+    ts.tv_sec = time / 1000000000;
+    ts.tv_nsec = time % 1000000000;
+    TimeScope scope(timer);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR)
+        ;
+}
+
+template<class T>
+void EmulatedPlayer<T>::send_message(int player, const octetStream& o) const
+{
+    octetStream stamped;
+    stamp(stamped, o, player);
+    T::send_message(player, stamped);
+}
+
+template<class T>
+void EmulatedPlayer<T>::receive_message(int player, octetStream& o) const
+{
+    T::receive_message(player, o);
+    wait_until(unstamp(o), waiting);
+}
+
+template<class T>
+void EmulatedPlayer<T>::transfer(const vector<const octetStream*>& sends,
+        const vector<octetStream*>& receives) const
+{
+    vector<octetStream> stamped(sends.size());
+    vector<const octetStream*> stamped_sends(sends.size());
+    for (size_t i = 0; i < sends.size(); i++)
+        if (sends[i])
+        {
+            stamp(stamped[i], *sends[i], i);
+            stamped_sends[i] = &stamped[i];
+        }
+    T::transfer(stamped_sends, receives);
+    uint64_t latest = 0;
+    for (auto receive : receives)
+        if (receive)
+            latest = max(latest, unstamp(*receive));
+    wait_until(latest, waiting);
+}
+
+template<class T>
+void EmulatedPlayer<T>::exchange(int other, octetStream& o) const
+{
+    this->send_receive(other, other, o);
+}
+
+template<class T>
+void EmulatedPlayer<T>::pass_around(octetStream& o, int offset) const
+{
+    this->send_receive(positive_modulo(this->my_num() + offset, this->num_players()),
+            positive_modulo(this->my_num() - offset, this->num_players()), o);
+}
+
+template class EmulatedPlayer<Player>;
+template class EmulatedPlayer<ShmPlayer>;
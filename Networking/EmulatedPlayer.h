@@ -0,0 +1,82 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * EmulatedPlayer.h
+ *
+ */
+
+#ifndef NETWORKING_EMULATEDPLAYER_H_
+#define NETWORKING_EMULATEDPLAYER_H_
+
+#include "Networking/Player.h"
+
+#include <random>
+#include <stdint.h>
+
+// Properties of the link from one player to another
+struct LinkEmulation
+{
+    // milliseconds
+    double latency, jitter;
+    // Mbit/s, 0 for unlimited
+    double bandwidth;
+
+    LinkEmulation() : latency(0), jitter(0), bandwidth(0) {}
+};
+
+/*
+ * Network description, one link per line:
+ *   <from> <to> <latency ms> <bandwidth Mbit/s> [<jitter ms>]
+ * where players can be * for all. Later lines take precedence.
+ * See NETWORK.example.
+ */
+class NetworkEmulation
+{
+public:
+    // Emulate the network described in this file if not empty (-ne)
+    static string filename;
+
+    // Links from a player to everyone
+    static vector<LinkEmulation> read_links(const string& filename,
+            int from, int nplayers);
+};
+
+/*
+ * Adds latency, bandwidth limits and jitter to the transport of
+ * another player class. The sender computes when a message would
+ * arrive given the properties of its link and earlier messages
+ * on it, and appends this time to the message. The receiver waits
+ * until then. This requires a clock shared by all players, that is,
+ * all players on the same host.
+ */
+template<class T>
+class EmulatedPlayer : public T
+{
+    vector<LinkEmulation> links;
+    // when the link is idle again, in nanoseconds
+    mutable vector<uint64_t> link_free;
+    // to keep the order with jitter
+    mutable vector<uint64_t> last_arrival;
+    mutable minstd_rand jitter_engine;
+
+    uint64_t arrival(int player, size_t length) const;
+    void stamp(octetStream& stamped, const octetStream& o, int player) const;
+    uint64_t unstamp(octetStream& o) const;
+
+protected:
+    void send_message(int player, const octetStream& o) const;
+    void receive_message(int player, octetStream& o) const;
+    void transfer(const vector<const octetStream*>& sends,
+        const vector<octetStream*>& receives) const;
+
+public:
+    mutable Timer waiting;
+
+    EmulatedPlayer(const Names& Nms, int id_base = 0);
+    ~EmulatedPlayer();
+
+    void exchange(int other, octetStream& o) const;
+    void pass_around(octetStream& o, int offset = 1) const;
+};
+
+#endif /* NETWORKING_EMULATEDPLAYER_H_ */
@@ -0,0 +1,170 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * EpollPlayer.cpp
+ *
+ */
+
+#include "Networking/EpollPlayer.h"
+#include "Exceptions/Exceptions.h"
+
+#include <sys/epoll.h>
+
+bool EpollPlayer::enabled = false;
+
+EpollPlayer::EpollPlayer(const Names& Nms, int id_base) :
+        Player(Nms, id_base, true)
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+        error("epoll_create1");
+    connections.resize(nplayers);
+    for (int i = 0; i < nplayers; i++)
+        connections[i].socket = sockets[i];
+}
+
+EpollPlayer::~EpollPlayer()
+{
+    close(epoll_fd);
+}
+
+void EpollPlayer::progress_receive(Connection& c) const
+{
+    while (not c.receiving.empty() and c.receiving.front().progress())
+        c.receiving.pop_front();
+}
+
+void EpollPlayer::progress_send(Connection& c) const
+{
+    c.sending.progress();
+}
+
+// only register sockets with pending operations
+// to avoid wake-ups for peers that have closed
+void EpollPlayer::update_events(Connection& c) const
+{
+    uint32_t events = (c.receiving.empty() ? 0u : (uint32_t)EPOLLIN)
+            | (c.sending.complete() ? 0u : (uint32_t)EPOLLOUT);
+    if (events == c.events)
+        return;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = &c;
+    int op;
+    if (c.events == 0)
+        op = EPOLL_CTL_ADD;
+    else if (events == 0)
+        op = EPOLL_CTL_DEL;
+    else
+        op = EPOLL_CTL_MOD;
+    if (epoll_ctl(epoll_fd, op, c.socket, &ev) < 0)
+        error("epoll_ctl");
+    c.events = events;
+}
+
+void EpollPlayer::run_once() const
+{
+    struct epoll_event events[nplayers];
+    int n = epoll_wait(epoll_fd, events, nplayers, timeout_ms);
+    if (n < 0)
+    {
+        if (errno == EINTR)
+            return;
+        error("epoll_wait");
+    }
+    if (n == 0)
+        throw runtime_error("timeout waiting for other players");
+
+    for (int i = 0; i < n; i++)
+    {
+        Connection& c = *(Connection*)events[i].data.ptr;
+        progress_send(c);
+        progress_receive(c);
+        update_events(c);
+    }
+}
+
+void EpollPlayer::start_send(int i, const octetStream& o) const
+{
+    Connection& c = connections[i];
+    if (not c.sending.complete())
+        throw not_implemented();
+    c.sending = PendingSend(c.socket, o);
+    progress_send(c);
+    update_events(c);
+}
+
+bool EpollPlayer::is_receiving(int i, const octetStream& o) const
+{
+    for (auto& receive : connections[i].receiving)
+        if (receive.get_stream() == &o)
+            return true;
+    return false;
+}
+
+void EpollPlayer::request_receive(int i, octetStream& o) const
+{
+    Connection& c = connections[i];
+    c.receiving.push_back(PendingReceive(c.socket, o));
+    progress_receive(c);
+    update_events(c);
+}
+
+void EpollPlayer::wait_receive(int i, octetStream& o, bool donthash) const
+{
+    TimeScope ts(timer);
+    double start = traffic ? traffic->now() : 0;
+    while (is_receiving(i, o))
+        run_once();
+    if (traffic)
+        traffic->received(i, o.get_length(), start);
+    if (!donthash)
+        hash->update(o);
+}
+
+void EpollPlayer::receive_player(int i, octetStream& o, bool donthash) const
+{
+    request_receive(i, o);
+    wait_receive(i, o, donthash);
+}
+
+void EpollPlayer::send_to(int player, const octetStream& o,
+        bool donthash) const
+{
+    if (player == player_no)
+    {
+        Player::send_to(player, o, donthash);
+        return;
+    }
+
+    TimeScope ts(timer);
+    start_send(player, o);
+    if (!donthash)
+        hash->update(o);
+    while (not connections[player].sending.complete())
+        run_once();
+    if (traffic)
+        traffic->sent(player, o.get_length());
+    sent += o.get_length();
+}
+
+void EpollPlayer::send_all(const octetStream& o, bool donthash) const
+{
+    TimeScope ts(timer);
+    for (int i = 0; i < nplayers; i++)
+        if (i != player_no)
+            start_send(i, o);
+
+    if (!donthash)
+        hash->update(o);
+
+    for (int i = 0; i < nplayers; i++)
+        while (not connections[i].sending.complete())
+            run_once();
+    if (traffic)
+        for (int i = 0; i < nplayers; i++)
+            if (i != player_no)
+                traffic->sent(i, o.get_length());
+    sent += o.get_length() * (num_players() - 1);
+}
@@ -0,0 +1,66 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * EpollPlayer.h
+ *
+ */
+
+#ifndef NETWORKING_EPOLLPLAYER_H_
+#define NETWORKING_EPOLLPLAYER_H_
+
+#include "Networking/Player.h"
+
+#include <deque>
+using namespace std;
+
+/*
+ * Player driving all connections from one epoll event loop run by
+ * the calling thread, so there are no extra threads per peer.
+ * Sockets stay in blocking mode for the inherited methods, the loop
+ * uses non-blocking calls. Operations on different peers progress
+ * while waiting for any one of them.
+ * Sending to oneself is left to the blocking base class.
+ */
+class EpollPlayer : public Player
+{
+    struct Connection
+    {
+        int socket;
+        // events registered with epoll
+        uint32_t events;
+        // requested receptions in order, the first is in progress
+        deque<PendingReceive> receiving;
+        PendingSend sending;
+
+        Connection() : socket(-1), events(0) {}
+    };
+
+    int epoll_fd;
+    mutable vector<Connection> connections;
+
+    // as much as possible without blocking
+    void progress_receive(Connection& c) const;
+    void progress_send(Connection& c) const;
+    void update_events(Connection& c) const;
+    // wait for at least one event and handle it
+    void run_once() const;
+
+    void start_send(int i, const octetStream& o) const;
+    bool is_receiving(int i, const octetStream& o) const;
+
+public:
+    // Use this instead of Player and ThreadPlayer (-e)
+    static bool enabled;
+
+    EpollPlayer(const Names& Nms, int id_base = 0);
+    virtual ~EpollPlayer();
+
+    void request_receive(int i, octetStream& o) const;
+    void wait_receive(int i, octetStream& o, bool donthash = false) const;
+    void receive_player(int i, octetStream& o, bool donthash = false) const;
+
+    void send_to(int player, const octetStream& o, bool donthash = false) const;
+    void send_all(const octetStream& o, bool donthash = false) const;
+};
+
+#endif /* NETWORKING_EPOLLPLAYER_H_ */
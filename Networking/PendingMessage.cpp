@@ -0,0 +1,254 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * PendingMessage.cpp
+ *
+ */
+
+#include "Networking/PendingMessage.h"
+#include "Exceptions/Exceptions.h"
+
+// true if the call has to be repeated later
+static bool would_block(ssize_t res, const char* msg)
+{
+    if (res > 0)
+        return false;
+    if (res == 0)
+        error(msg, " - connection closed");
+    if (errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR)
+        return true;
+    error(msg);
+    return false;
+}
+
+int Stripes::count = 1;
+size_t Stripes::threshold = 1 << 20;
+
+// even split with the first part on the main connection
+static size_t split(size_t length, const Stripes* stripes,
+        vector<PendingStripe>& res)
+{
+    if (stripes == 0 or not stripes->used_for(length))
+        return length;
+    size_t n = stripes->sockets.size() + 1;
+    for (size_t i = 1; i < n; i++)
+        res.push_back({stripes->sockets[i - 1], length * i / n,
+                length * (i + 1) / n});
+    return length / n;
+}
+
+// returns true if all done, removes finished stripes
+static bool send_stripes(vector<PendingStripe>& stripes, const octet* data)
+{
+    size_t j = 0;
+    for (size_t i = 0; i < stripes.size(); i++)
+    {
+        PendingStripe& stripe = stripes[i];
+        while (stripe.begin < stripe.end)
+        {
+            ssize_t res = send(stripe.socket, data + stripe.begin,
+                    stripe.end - stripe.begin, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (would_block(res, "Send error - 3"))
+                break;
+            stripe.begin += res;
+        }
+        if (stripe.begin < stripe.end)
+            stripes[j++] = stripe;
+    }
+    stripes.resize(j);
+    return j == 0;
+}
+
+static bool receive_stripes(vector<PendingStripe>& stripes, octet* data)
+{
+    size_t j = 0;
+    for (size_t i = 0; i < stripes.size(); i++)
+    {
+        PendingStripe& stripe = stripes[i];
+        while (stripe.begin < stripe.end)
+        {
+            ssize_t res = recv(stripe.socket, data + stripe.begin,
+                    stripe.end - stripe.begin, MSG_DONTWAIT);
+            if (would_block(res, "Receiving error - 2"))
+                break;
+            stripe.begin += res;
+        }
+        if (stripe.begin < stripe.end)
+            stripes[j++] = stripe;
+    }
+    stripes.resize(j);
+    return j == 0;
+}
+
+PendingSend::PendingSend(int socket, const octetStream& os,
+        const Stripes* stripes) :
+        socket(socket), os(&os), done(0)
+{
+    encode_length(header, os.get_length(), LENGTH_SIZE);
+    main_length = split(os.get_length(), stripes, this->stripes);
+}
+
+bool PendingSend::progress()
+{
+    if (complete())
+        return true;
+
+    size_t total = LENGTH_SIZE + main_length;
+    while (done < total)
+    {
+        // header and data in one call as in octetStream::Send()
+        struct iovec iov[2];
+        int n = 0;
+        if (done < LENGTH_SIZE)
+        {
+            iov[n].iov_base = header + done;
+            iov[n].iov_len = LENGTH_SIZE - done;
+            n++;
+        }
+        size_t body_done = max(done, (size_t)LENGTH_SIZE) - LENGTH_SIZE;
+        if (body_done < main_length)
+        {
+            iov[n].iov_base = os->get_data() + body_done;
+            iov[n].iov_len = main_length - body_done;
+            n++;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        ssize_t res = sendmsg(socket, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (would_block(res, "Send error - 3"))
+            break;
+        done += res;
+    }
+
+    if (not send_stripes(stripes, os->get_data()) or done < total)
+        return false;
+
+    sent_amount += LENGTH_SIZE + os->get_length();
+    sent_counter++;
+    return true;
+}
+
+void PendingSend::add_fds(vector<struct pollfd>& fds) const
+{
+    if (os and done < LENGTH_SIZE + main_length)
+        fds.push_back({socket, POLLOUT, 0});
+    for (auto& stripe : stripes)
+        fds.push_back({stripe.socket, POLLOUT, 0});
+}
+
+PendingReceive::PendingReceive(int socket, octetStream& os,
+        const Stripes* stripes) :
+        socket(socket), os(&os), all_stripes(stripes), done(0),
+        main_length(0)
+{
+}
+
+bool PendingReceive::progress()
+{
+    while (done < LENGTH_SIZE + main_length)
+    {
+        ssize_t res;
+        if (done < LENGTH_SIZE)
+        {
+            res = recv(socket, header + done, LENGTH_SIZE - done, MSG_DONTWAIT);
+            if (would_block(res, "Receiving error - 2"))
+                break;
+            done += res;
+            if (done < LENGTH_SIZE)
+                continue;
+            size_t length = decode_length(header, LENGTH_SIZE);
+            // exactly the right size unless the buffer is large enough
+            os->reset_write_head();
+            if (length > os->get_max_length())
+                os->resize_precise(length);
+            os->append(length);
+            main_length = split(length, all_stripes, stripes);
+        }
+
+        size_t body_done = done - LENGTH_SIZE;
+        if (body_done < main_length)
+        {
+            res = recv(socket, os->get_data() + body_done,
+                    main_length - body_done, MSG_DONTWAIT);
+            if (would_block(res, "Receiving error - 2"))
+                break;
+            done += res;
+        }
+    }
+    return receive_stripes(stripes, os->get_data()) and complete();
+}
+
+void PendingReceive::add_fds(vector<struct pollfd>& fds) const
+{
+    if (done < LENGTH_SIZE + main_length)
+        fds.push_back({socket, POLLIN, 0});
+    for (auto& stripe : stripes)
+        fds.push_back({stripe.socket, POLLIN, 0});
+}
+
+static bool any_ready(const vector<struct pollfd>& fds, size_t begin,
+        size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        if (fds[i].revents)
+            return true;
+    return false;
+}
+
+void transfer_all(vector<PendingSend>& sends, vector<PendingReceive>& receives,
+        int timeout_ms)
+{
+    // try everything once, then only what poll() reports ready
+    vector<struct pollfd> fds;
+    vector<size_t> ends;
+    vector<PendingSend*> waiting_sends;
+    vector<PendingReceive*> waiting_receives;
+    for (auto& send : sends)
+        if (not send.progress())
+            waiting_sends.push_back(&send);
+    for (auto& receive : receives)
+        if (not receive.progress())
+            waiting_receives.push_back(&receive);
+
+    while (not (waiting_sends.empty() and waiting_receives.empty()))
+    {
+        // several sockets per transfer when striping
+        fds.clear();
+        ends.clear();
+        for (auto send : waiting_sends)
+        {
+            send->add_fds(fds);
+            ends.push_back(fds.size());
+        }
+        for (auto receive : waiting_receives)
+        {
+            receive->add_fds(fds);
+            ends.push_back(fds.size());
+        }
+
+        int res = poll(fds.data(), fds.size(), timeout_ms);
+        if (res < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            error("poll");
+        }
+        if (res == 0)
+            throw runtime_error("timeout waiting for other players");
+
+        size_t j = 0, k = 0, begin = 0;
+        for (size_t i = 0; i < waiting_sends.size(); i++, begin = ends[k++])
+            if (not (any_ready(fds, begin, ends[k])
+                    and waiting_sends[i]->progress()))
+                waiting_sends[j++] = waiting_sends[i];
+        waiting_sends.resize(j);
+        j = 0;
+        for (size_t i = 0; i < waiting_receives.size(); i++, begin = ends[k++])
+            if (not (any_ready(fds, begin, ends[k])
+                    and waiting_receives[i]->progress()))
+                waiting_receives[j++] = waiting_receives[i];
+        waiting_receives.resize(j);
+    }
+}
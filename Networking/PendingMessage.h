@@ -0,0 +1,101 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * PendingMessage.h
+ *
+ */
+
+#ifndef NETWORKING_PENDINGMESSAGE_H_
+#define NETWORKING_PENDINGMESSAGE_H_
+
+#include "Tools/octetStream.h"
+
+#include <poll.h>
+#include <vector>
+using namespace std;
+
+// timeout when waiting for the network, same as SO_RCVTIMEO
+#define NETWORK_TIMEOUT_MS 300000
+
+/*
+ * Additional connections to one player. The body of a message of
+ * at least threshold bytes is split evenly over the main connection
+ * and these, without further headers. The receiver recognizes such
+ * messages by the length, so all players must use the same settings.
+ */
+class Stripes
+{
+public:
+    // Connections per player including the main one (--stripes)
+    static int count;
+    // Minimum message length for splitting (--stripe-threshold)
+    static size_t threshold;
+
+    vector<int> sockets;
+
+    bool used_for(size_t length) const
+    {
+        return not sockets.empty() and length >= threshold;
+    }
+};
+
+// Range of a message body on an additional connection
+struct PendingStripe
+{
+    int socket;
+    size_t begin, end;
+};
+
+/*
+ * Transfer of one octetStream with its length header using
+ * non-blocking calls on a blocking socket, in the same format as
+ * octetStream::Send() and Receive(). progress() does as much
+ * as possible without waiting and returns whether it is done.
+ * Large messages are striped if additional connections are given.
+ */
+class PendingSend
+{
+    int socket;
+    const octetStream* os;
+    octet header[LENGTH_SIZE];
+    // progress on the main connection including the header
+    size_t done, main_length;
+    vector<PendingStripe> stripes;
+
+public:
+    // nothing to send
+    PendingSend() : socket(-1), os(0), done(0), main_length(0) {}
+    PendingSend(int socket, const octetStream& os, const Stripes* stripes = 0);
+
+    int get_socket() const { return socket; }
+    bool complete() const { return os == 0 or (done == LENGTH_SIZE + main_length and stripes.empty()); }
+    bool progress();
+    // sockets to wait for
+    void add_fds(vector<struct pollfd>& fds) const;
+};
+
+class PendingReceive
+{
+    int socket;
+    octetStream* os;
+    const Stripes* all_stripes;
+    octet header[LENGTH_SIZE];
+    size_t done, main_length;
+    vector<PendingStripe> stripes;
+
+public:
+    PendingReceive(int socket, octetStream& os, const Stripes* stripes = 0);
+
+    int get_socket() const { return socket; }
+    octetStream* get_stream() const { return os; }
+    bool complete() const { return done >= LENGTH_SIZE and done == LENGTH_SIZE + main_length and stripes.empty(); }
+    bool progress();
+    void add_fds(vector<struct pollfd>& fds) const;
+};
+
+// Run all transfers concurrently until they are complete,
+// receptions finish in order of arrival, -1 to wait indefinitely
+void transfer_all(vector<PendingSend>& sends, vector<PendingReceive>& receives,
+        int timeout_ms = NETWORK_TIMEOUT_MS);
+
+#endif /* NETWORKING_PENDINGMESSAGE_H_ */
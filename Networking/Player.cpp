@@ -167,21 +167,36 @@ Names::~Names()
 
 
 
-Player::Player(const Names& Nms, int id) :
-        PlayerBase(Nms.my_num()), send_to_self_socket(-1)
+Player::Player(const Names& Nms, int id, bool connect, bool stripe) :
+        PlayerBase(Nms.my_num()), send_to_self_socket(-1),
+        timeout_ms(NETWORK_TIMEOUT_MS)
 {
   nplayers=Nms.nplayers;
   player_no=Nms.player_no;
-  setup_sockets(Nms.names, Nms.ports, id, *Nms.server);
-  blk_SHA1_Init(&ctx);
+  if (connect)
+    setup_sockets(Nms.names, Nms.ports, id, *Nms.server);
+  if (connect and stripe and Stripes::count > 1)
+    setup_stripes(Nms.names, Nms.ports, id, *Nms.server);
+  hash = BroadcastHash::create();
+  traffic = 0;
+  if (TrafficStats::enabled)
+    { stringstream filename;
+      filename << PREP_DIR "Traffic-P" << player_no << "-" << hex << id;
+      traffic = new TrafficStats(nplayers, filename.str());
+    }
 }
 
 
 Player::~Player()
 {
+  delete hash;
+  delete traffic;
   /* Close down the sockets */
-  for (int i=0; i<nplayers; i++)
+  for (size_t i=0; i<sockets.size(); i++)
     close_client_socket(sockets[i]);
+  for (size_t i=0; i<stripes.size(); i++)
+    for (size_t j=0; j<stripes[i].sockets.size(); j++)
+      close_client_socket(stripes[i].sockets[j]);
 }
 
 
@@ -192,17 +207,25 @@ Player::~Player()
 void Player::setup_sockets(const vector<string>& names,const vector<int>& ports,int id_base,ServerSocket& server)
 {
     sockets.resize(nplayers);
-    // Set up the client side
+    // Set up the client side, all connections at once
+    vector<string> hostnames;
+    vector<int> client_ports, client_sockets;
     for (int i=player_no; i<nplayers; i++) {
         int pn=id_base+i*nplayers+player_no;
         if (i==player_no) {
           const char* localhost = "127.0.0.1";
           fprintf(stderr, "Setting up send to self socket to %s:%d with id 0x%x\n",localhost,ports[i],pn);
-          set_up_client_socket(sockets[i],localhost,ports[i]);
+          hostnames.push_back(localhost);
         } else {
           fprintf(stderr, "Setting up client to %s:%d with id 0x%x\n",names[i].c_str(),ports[i],pn);
-          set_up_client_socket(sockets[i],names[i].c_str(),ports[i]);
+          hostnames.push_back(names[i]);
         }
+        client_ports.push_back(ports[i]);
+    }
+    set_up_client_sockets(client_sockets, hostnames, client_ports);
+    for (int i=player_no; i<nplayers; i++) {
+        int pn=id_base+i*nplayers+player_no;
+        sockets[i] = client_sockets[i-player_no];
         send(sockets[i], (unsigned char*)&pn, sizeof(pn));
     }
     send_to_self_socket = sockets[player_no];
@@ -224,14 +247,120 @@ void Player::setup_sockets(const vector<string>& names,const vector<int>& ports,
     }
 }
 
+void Player::set_timeout(int seconds)
+{
+    timeout_ms = seconds ? seconds * 1000 : -1;
+    struct timeval tv;
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    for (int i = 0; i < nplayers; i++)
+        if (setsockopt(sockets[i], SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(struct timeval)) < 0)
+            error("set_timeout:setsockopt");
+}
+
+
+// Ids of additional connections between the pair index
+// and the thread number, for at most 16 players and stripes
+void Player::setup_stripes(const vector<string>& names,const vector<int>& ports,int id_base,ServerSocket& server)
+{
+    if (Stripes::count > 16 or nplayers > 16)
+      throw runtime_error("at most 16 stripes and players supported");
+    stripes.resize(nplayers);
+    vector<string> hostnames;
+    vector<int> client_ports, client_sockets, ids;
+    for (int s=1; s<Stripes::count; s++)
+        for (int i=player_no+1; i<nplayers; i++) {
+            int pn=id_base+(s<<12)+i*nplayers+player_no;
+            fprintf(stderr, "Setting up stripe client to %s:%d with id 0x%x\n",names[i].c_str(),ports[i],pn);
+            hostnames.push_back(names[i]);
+            client_ports.push_back(ports[i]);
+            ids.push_back(pn);
+        }
+    set_up_client_sockets(client_sockets, hostnames, client_ports);
+    size_t k=0;
+    for (int s=1; s<Stripes::count; s++) {
+        int stripe_base=id_base+(s<<12);
+        for (int i=player_no+1; i<nplayers; i++, k++) {
+            send(client_sockets[k], (unsigned char*)&ids[k], sizeof(ids[k]));
+            stripes[i].sockets.push_back(client_sockets[k]);
+        }
+        for (int i=0; i<player_no; i++) {
+            int id=stripe_base+player_no*nplayers+i;
+            fprintf(stderr, "As a server, waiting for stripe client with id 0x%x to connect.\n",id);
+            stripes[i].sockets.push_back(server.get_connection_socket(id));
+        }
+    }
+}
+
+
+void Player::send_message(int player, const octetStream& o) const
+{
+  if (player!=player_no and stripes.size() and stripes[player].used_for(o.get_length()))
+    { vector<PendingSend> sends = { PendingSend(sockets[player], o, &stripes[player]) };
+      vector<PendingReceive> receives;
+      transfer_all(sends, receives, timeout_ms);
+    }
+  else
+    { o.Send(socket_to_send(player)); }
+}
+
+
+void Player::receive_message(int player, octetStream& o) const
+{
+  o.reset_write_head();
+  if (player!=player_no and stripes.size())
+    { vector<PendingSend> sends;
+      vector<PendingReceive> receives = { PendingReceive(sockets[player], o, &stripes[player]) };
+      transfer_all(sends, receives, timeout_ms);
+    }
+  else
+    { o.Receive(sockets[player]); }
+}
+
+
+void Player::transfer(const vector<const octetStream*>& sends,
+    const vector<octetStream*>& receives) const
+{
+  vector<PendingSend> pending_sends;
+  vector<PendingReceive> pending_receives;
+  for (int i=0; i<nplayers; i++)
+     { const Stripes* s = (i==player_no or stripes.empty()) ? 0 : &stripes[i];
+       if (sends[i])
+         { pending_sends.push_back(PendingSend(socket_to_send(i), *sends[i], s)); }
+       if (receives[i])
+         { pending_receives.push_back(PendingReceive(sockets[i], *receives[i], s)); }
+     }
+  transfer_all(pending_sends, pending_receives, timeout_ms);
+}
+
+
+void Player::send_receive(int to, int from, octetStream& o) const
+{
+  TimeScope ts(timer);
+  vector<const octetStream*> sends(nplayers);
+  vector<octetStream*> receives(nplayers);
+  octetStream received;
+  sends.at(to) = &o;
+  receives.at(from) = &received;
+  double start = traffic ? traffic->now() : 0;
+  transfer(sends, receives);
+  if (traffic)
+    { traffic->sent(to, o.get_length());
+      traffic->received(from, received.get_length(), start);
+    }
+  sent += o.get_length();
+  o.swap(received);
+}
+
 
 void Player::send_to(int player,const octetStream& o,bool donthash) const
 {
   TimeScope ts(timer);
-  int socket = socket_to_send(player);
-  o.Send(socket);
+  send_message(player, o);
+  if (traffic)
+    { traffic->sent(player, o.get_length()); }
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash->update(o); }
   sent += o.get_length();
 }
 
@@ -239,12 +368,19 @@ void Player::send_to(int player,const octetStream& o,bool donthash) const
 void Player::send_all(const octetStream& o,bool donthash) const
 {
   TimeScope ts(timer);
-  for (int i=0; i<nplayers; i++)
-     { if (i!=player_no)
-         { o.Send(sockets[i]); }
-     }
+  // to all players at once
+  vector<const octetStream*> sends(nplayers, &o);
+  vector<octetStream*> receives(nplayers);
+  sends[player_no] = 0;
+  transfer(sends, receives);
+  if (traffic)
+    { for (int i=0; i<nplayers; i++)
+        { if (i!=player_no)
+            { traffic->sent(i, o.get_length()); }
+        }
+    }
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash->update(o); }
   sent += o.get_length() * (num_players() - 1);
 }
 
@@ -252,55 +388,76 @@ void Player::send_all(const octetStream& o,bool donthash) const
 void Player::receive_player(int i,octetStream& o,bool donthash) const
 {
   TimeScope ts(timer);
-  o.reset_write_head();
-  o.Receive(sockets[i]);
+  double start = traffic ? traffic->now() : 0;
+  receive_message(i, o);
+  if (traffic)
+    { traffic->received(i, o.get_length(), start); }
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash->update(o); }
 }
 
 
 void Player::exchange(int other, octetStream& o) const
 {
+  if (stripes.size())
+    { send_receive(other, other, o);
+      return;
+    }
   TimeScope ts(timer);
+  double start = traffic ? traffic->now() : 0;
+  if (traffic)
+    { traffic->sent(other, o.get_length()); }
   o.exchange(sockets[other], sockets[other]);
+  if (traffic)
+    { traffic->received(other, o.get_length(), start); }
   sent += o.get_length();
 }
 
 
 void Player::pass_around(octetStream& o, int offset) const
 {
+  int to = (my_num() + offset) % num_players();
+  int from = (my_num() + num_players() - offset) % num_players();
+  if (stripes.size())
+    { send_receive(to, from, o);
+      return;
+    }
   TimeScope ts(timer);
-  o.exchange(sockets.at((my_num() + offset) % num_players()),
-      sockets.at((my_num() + num_players() - offset) % num_players()));
+  double start = traffic ? traffic->now() : 0;
+  if (traffic)
+    { traffic->sent(to, o.get_length()); }
+  o.exchange(sockets.at(to), sockets.at(from));
+  if (traffic)
+    { traffic->received(from, o.get_length(), start); }
   sent += o.get_length();
 }
 
 
-/* This is deliberately weird to avoid problems with OS max buffer
- * size getting in the way
+/* Sending and receiving happen concurrently on all sockets,
+ * so the OS buffer sizes do not matter
  */
 void Player::Broadcast_Receive(vector<octetStream>& o,bool donthash) const
 {
   TimeScope ts(timer);
+  vector<const octetStream*> sends(nplayers, &o[player_no]);
+  vector<octetStream*> receives(nplayers);
   for (int i=0; i<nplayers; i++)
-     { if (i>player_no)
-	 { o[player_no].Send(sockets[i]); }
-       else if (i<player_no)
-         { o[i].reset_write_head();
-           o[i].Receive(sockets[i]);
-         }
-     }
-  for (int i=0; i<nplayers; i++)
-     { if (i<player_no)
-         { o[player_no].Send(sockets[i]); }
-       else if (i>player_no)
-         { o[i].reset_write_head();
-           o[i].Receive(sockets[i]);
-         }
-     }
+     { receives[i] = &o[i]; }
+  sends[player_no] = 0;
+  receives[player_no] = 0;
+  double start = traffic ? traffic->now() : 0;
+  transfer(sends, receives);
+  if (traffic)
+    { for (int i=0; i<nplayers; i++)
+        { if (i!=player_no)
+            { traffic->sent(i, o[player_no].get_length());
+              traffic->received(i, o[i].get_length(), start);
+            }
+        }
+    }
   if (!donthash)
     { for (int i=0; i<nplayers; i++)
-        { blk_SHA1_Update(&ctx,o[i].get_data(),o[i].get_length()); }
+        { hash->update(o[i]); }
     }
   sent += o[player_no].get_length() * (num_players() - 1);
 }
@@ -308,10 +465,8 @@ void Player::Broadcast_Receive(vector<octetStream>& o,bool donthash) const
 
 void Player::Check_Broadcast() const
 {
-  octet hashVal[HASH_SIZE];
   vector<octetStream> h(nplayers);
-  blk_SHA1_Final(hashVal,&ctx);
-  h[player_no].append(hashVal,HASH_SIZE);
+  hash->final(h[player_no]);
 
   Broadcast_Receive(h,true);
   for (int i=0; i<nplayers; i++)
@@ -320,7 +475,6 @@ void Player::Check_Broadcast() const
 	    { throw broadcast_invalid(); }
         }
     }
-  blk_SHA1_Init(&ctx);
 }
 
 
@@ -360,7 +514,7 @@ void Player::wait_for_available(vector<int>& players, vector<int>& result) const
 }
 
 
-ThreadPlayer::ThreadPlayer(const Names& Nms, int id_base) : Player(Nms, id_base)
+ThreadPlayer::ThreadPlayer(const Names& Nms, int id_base) : Player(Nms, id_base, true)
 {
   for (int i = 0; i < Nms.num_players(); i++)
     {
@@ -398,9 +552,12 @@ void ThreadPlayer::request_receive(int i, octetStream& o) const
 
 void ThreadPlayer::wait_receive(int i, octetStream& o, bool donthash) const
 {
+  double start = traffic ? traffic->now() : 0;
   receivers[i]->wait(o);
+  if (traffic)
+    { traffic->received(i, o.get_length(), start); }
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash->update(o); }
 }
 
 void ThreadPlayer::receive_player(int i, octetStream& o, bool donthash) const
@@ -417,16 +574,22 @@ void ThreadPlayer::send_all(const octetStream& o,bool donthash) const
      }
 
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash->update(o); }
 
   for (int i = 0; i < nplayers; i++)
     if (i != player_no)
       senders[i]->wait(o);
+
+  if (traffic)
+    for (int i = 0; i < nplayers; i++)
+      if (i != player_no)
+        traffic->sent(i, o.get_length());
 }
 
 
 TwoPartyPlayer::TwoPartyPlayer(const Names& Nms, int other_player, int id) :
-        PlayerBase(Nms.my_num()), other_player(other_player)
+        PlayerBase(Nms.my_num()), other_player(other_player),
+        send_cipher(0), recv_cipher(0)
 {
   is_server = Nms.my_num() > other_player;
   setup_sockets(other_player, Nms, Nms.ports[other_player], id);
@@ -437,6 +600,8 @@ TwoPartyPlayer::~TwoPartyPlayer()
   for(size_t i=0; i < my_secret_key.size(); i++) {
       my_secret_key[i] = 0;
   }
+  delete send_cipher;
+  delete recv_cipher;
   close_client_socket(socket);
 }
 
@@ -522,6 +687,10 @@ void TwoPartyPlayer::setup_sockets(int other_player, const Names &nms, int portN
         }
     }
     p2pcommsec = (0 != nms.keys);
+    if (p2pcommsec) {
+        send_cipher = SequenceCipher::create(player_send_key.first);
+        recv_cipher = SequenceCipher::create(player_recv_key.first);
+    }
 }
 
 int TwoPartyPlayer::other_player_num() const
@@ -532,7 +701,7 @@ int TwoPartyPlayer::other_player_num() const
 void TwoPartyPlayer::send(octetStream& o)
 {
   if(p2pcommsec) {
-    o.encrypt_sequence(&player_send_key.first[0], player_send_key.second);
+    send_cipher->encrypt(o, player_send_key.second);
     player_send_key.second++;
   }
   TimeScope ts(timer);
@@ -546,7 +715,7 @@ void TwoPartyPlayer::receive(octetStream& o)
   o.reset_write_head();
   o.Receive(socket);
   if(p2pcommsec) {
-    o.decrypt_sequence(&player_recv_key.first[0], player_recv_key.second);
+    recv_cipher->decrypt(o, player_recv_key.second);
     player_recv_key.second++;
   }
 }
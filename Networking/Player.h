@@ -19,7 +19,10 @@ using namespace std;
 #include "Tools/octetStream.h"
 #include "Networking/sockets.h"
 #include "Networking/ServerSocket.h"
-#include "Tools/sha1.h"
+#include "Networking/BroadcastHash.h"
+#include "Networking/SequenceCipher.h"
+#include "Networking/PendingMessage.h"
+#include "Networking/TrafficStats.h"
 #include "Networking/Receiver.h"
 #include "Networking/Sender.h"
 
@@ -124,18 +127,46 @@ protected:
 
   void setup_sockets(const vector<string>& names,const vector<int>& ports,int id_base,ServerSocket& server);
 
+  // additional connections for large messages, empty unless striping
+  vector<Stripes> stripes;
+
+  void setup_stripes(const vector<string>& names,const vector<int>& ports,int id_base,ServerSocket& server);
+
   int nplayers;
 
-  mutable blk_SHA_CTX ctx;
+  // for waiting in transfer_all() and event loops, -1 for no timeout
+  int timeout_ms;
+
+  BroadcastHash* hash;
 
   map<int,int> socket_players;
 
   int socket_to_send(int player) const { return player == player_no ? send_to_self_socket : sockets[player]; }
 
+  // Transport used by send_to(), send_all(), receive_player()
+  // and Broadcast_Receive()
+  virtual void send_message(int player, const octetStream& o) const;
+  virtual void receive_message(int player, octetStream& o) const;
+  // Send *sends[i] to and receive *receives[i] from player i
+  // concurrently, null pointers for nothing
+  virtual void transfer(const vector<const octetStream*>& sends,
+      const vector<octetStream*>& receives) const;
+  // exchange() and pass_around() using transfer(), at the cost of a copy
+  void send_receive(int to, int from, octetStream& o) const;
+
+  // Without sockets if connect is false, additional connections
+  // for large messages only if stripe is true and Stripes::count > 1
+  Player(const Names& Nms, int id_base, bool connect, bool stripe = false);
+
 public:
+  // 0 unless enabled
+  TrafficStats* traffic;
+  // Attribute my traffic to the tape and instruction run on P
+  void follow_traffic(const Player& P) { if (traffic) traffic->follow(P.traffic); }
+
   // The offset is used for the multi-threaded call, to ensure different
   // portnum bases in each thread
-  Player(const Names& Nms,int id_base=0);
+  Player(const Names& Nms,int id_base=0) : Player(Nms, id_base, true, true) {}
 
   virtual ~Player();
 
@@ -143,6 +174,9 @@ public:
   int my_num() const { return player_no; }
   int socket(int i) const { return sockets[i]; }
 
+  // Receive timeout on all connections, 0 to wait indefinitely
+  void set_timeout(int seconds);
+
   // Send/Receive data to/from player i 
   // 8-bit ints only (mainly for testing)
   void send_int(int i,int a)  const    { send(sockets[i],a);    }
@@ -151,7 +185,7 @@ public:
   // Send an octetStream to all other players 
   //   -- And corresponding receive
   virtual void send_all(const octetStream& o,bool donthash=false) const;
-  void send_to(int player,const octetStream& o,bool donthash=false) const;
+  virtual void send_to(int player,const octetStream& o,bool donthash=false) const;
   virtual void receive_player(int i,octetStream& o,bool donthash=false) const;
 
   // exchange data with minimal memory usage
@@ -168,7 +202,7 @@ public:
   void Broadcast_Receive(vector<octetStream>& o,bool donthash=false) const;
 
   /* Run Protocol To Verify Broadcast Is Correct
-   *     - Resets the blk_SHA_CTX at the same time
+   *     - Resets the hash at the same time
    */
   void Check_Broadcast() const;
 
@@ -213,6 +247,8 @@ private:
   map<int,public_signing_key> player_public_keys;
   keyinfo player_send_key;
   keyinfo player_recv_key;
+  SequenceCipher* send_cipher;
+  SequenceCipher* recv_cipher;
 
 public:
   TwoPartyPlayer(const Names& Nms, int other_player, int pn_offset=0);
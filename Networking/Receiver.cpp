@@ -33,26 +33,28 @@ void Receiver::stop()
 
 void Receiver::run()
 {
-    octetStream* os = 0;
+    octetStream os;
     while (in.pop(os))
     {
-        os->reset_write_head();
+        os.reset_write_head();
         timer.start();
-        os->Receive(socket);
+        os.Receive(socket);
         timer.stop();
-        out.push(os);
+        out.push(move(os));
     }
 }
 
+// os is empty until wait()
 void Receiver::request(octetStream& os)
 {
-    in.push(&os);
+    requested.push_back(&os);
+    in.push(move(os));
 }
 
 void Receiver::wait(octetStream& os)
 {
-    octetStream* queued = 0;
-    out.pop(queued);
-    if (queued != &os)
+    if (requested.empty() or requested.front() != &os)
       throw not_implemented();
+    requested.pop_front();
+    out.pop(os);
 }
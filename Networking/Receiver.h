@@ -9,17 +9,26 @@
 #define NETWORKING_RECEIVER_H_
 
 #include <pthread.h>
+#include <deque>
+using namespace std;
 
 #include "Tools/octetStream.h"
-#include "Tools/WaitQueue.h"
+#include "Tools/SpscQueue.h"
 #include "Tools/time-func.h"
 
+/*
+ * Receives in a separate thread. Buffers are moved to the thread
+ * on request and back on waiting, so a buffer of a suitable size
+ * keeps circulating between the two threads.
+ */
 class Receiver
 {
     int socket;
-    WaitQueue<octetStream*> in;
-    WaitQueue<octetStream*> out;
+    SpscQueue<octetStream> in;
+    SpscQueue<octetStream> out;
     pthread_t thread;
+    // requests in order, only used by the requesting thread
+    deque<octetStream*> requested;
 
     // prevent copying
     Receiver(const Receiver& other);
@@ -11,14 +11,14 @@
 #include <pthread.h>
 
 #include "Tools/octetStream.h"
-#include "Tools/WaitQueue.h"
+#include "Tools/SpscQueue.h"
 #include "Tools/time-func.h"
 
 class Sender
 {
     int socket;
-    WaitQueue<const octetStream*> in;
-    WaitQueue<const octetStream*> out;
+    SpscQueue<const octetStream*> in;
+    SpscQueue<const octetStream*> out;
     pthread_t thread;
 
     // prevent copying
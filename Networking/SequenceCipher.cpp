@@ -0,0 +1,107 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * SequenceCipher.cpp
+ *
+ */
+
+#include "Networking/SequenceCipher.h"
+#include "Exceptions/Exceptions.h"
+
+#include <stdlib.h>
+#include <stdexcept>
+
+SequenceCipher::Type SequenceCipher::default_type = SECRETBOX;
+
+SequenceCipher::Type SequenceCipher::parse_type(const string& name)
+{
+    if (name == "secretbox")
+        return SECRETBOX;
+    else if (name == "aes-gcm")
+    {
+        if (sodium_init() < 0 or not crypto_aead_aes256gcm_is_available())
+            throw runtime_error("AES-GCM needs AES-NI and PCLMUL");
+        return AES_GCM;
+    }
+    else
+        throw runtime_error("unknown commsec cipher: " + name);
+}
+
+SequenceCipher* SequenceCipher::create(const vector<octet>& key)
+{
+    if (key.size() != crypto_secretbox_KEYBYTES)
+        throw runtime_error("invalid commsec key length");
+    switch (default_type)
+    {
+    case SECRETBOX:
+        return new SecretboxSequenceCipher(key);
+    case AES_GCM:
+        return new AesGcmSequenceCipher(key);
+    default:
+        throw runtime_error("invalid commsec cipher");
+    }
+}
+
+SecretboxSequenceCipher::~SecretboxSequenceCipher()
+{
+    sodium_memzero(key.data(), key.size());
+}
+
+void SecretboxSequenceCipher::encrypt(octetStream& os, uint64_t counter)
+{
+    os.encrypt_sequence(key.data(), counter);
+}
+
+void SecretboxSequenceCipher::decrypt(octetStream& os, uint64_t counter)
+{
+    os.decrypt_sequence(key.data(), counter);
+}
+
+AesGcmSequenceCipher::AesGcmSequenceCipher(const vector<octet>& key)
+{
+    if (posix_memalign((void**)&state, 64, sizeof(*state)) != 0)
+        throw bad_alloc();
+    crypto_aead_aes256gcm_beforenm(state, key.data());
+}
+
+AesGcmSequenceCipher::~AesGcmSequenceCipher()
+{
+    sodium_memzero(state, sizeof(*state));
+    free(state);
+}
+
+// same counter convention as octetStream::encrypt_sequence()
+void AesGcmSequenceCipher::nonce(octet* res, uint64_t counter)
+{
+    if (counter == UINT64_MAX)
+        throw Processor_Error("Encryption would overflow counter. Too many messages.");
+    memset(res, 0, crypto_aead_aes256gcm_NPUBBYTES);
+    encode_length(res, counter + 1, 8);
+}
+
+void AesGcmSequenceCipher::encrypt(octetStream& os, uint64_t counter)
+{
+    octet npub[crypto_aead_aes256gcm_NPUBBYTES];
+    nonce(npub, counter);
+    size_t length = os.get_length();
+    // might move the data
+    octet* mac = os.append(crypto_aead_aes256gcm_ABYTES);
+    octet* data = os.get_data();
+    crypto_aead_aes256gcm_encrypt_detached_afternm(data, mac, 0, data, length,
+            0, 0, 0, npub, state);
+}
+
+void AesGcmSequenceCipher::decrypt(octetStream& os, uint64_t counter)
+{
+    if (os.get_length() < crypto_aead_aes256gcm_ABYTES)
+        throw Processor_Error("Cannot decrypt octetStream: ciphertext too short");
+    octet npub[crypto_aead_aes256gcm_NPUBBYTES];
+    nonce(npub, counter);
+    size_t length = os.get_length() - crypto_aead_aes256gcm_ABYTES;
+    octet* data = os.get_data();
+    // a wrong counter fails authentication
+    if (crypto_aead_aes256gcm_decrypt_detached_afternm(data, 0, data, length,
+            data + length, 0, 0, npub, state) != 0)
+        throw Processor_Error("octetStream decryption failed!");
+    os.rewind_write_head(crypto_aead_aes256gcm_ABYTES);
+}
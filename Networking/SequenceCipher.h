@@ -0,0 +1,79 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * SequenceCipher.h
+ *
+ */
+
+#ifndef NETWORKING_SEQUENCECIPHER_H_
+#define NETWORKING_SEQUENCECIPHER_H_
+
+#include "Tools/octetStream.h"
+
+#include <sodium.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*
+ * In-place authenticated encryption of octetStreams between players,
+ * with the message counter as nonce so that reordering and replay are
+ * detected. Keys have crypto_secretbox_KEYBYTES octets for all types,
+ * and all players must use the same type.
+ */
+class SequenceCipher
+{
+public:
+    enum Type
+    {
+        SECRETBOX, AES_GCM
+    };
+
+    // Set by --commsec-cipher, used for the external client connections
+    // and by TwoPartyPlayer
+    static Type default_type;
+
+    static Type parse_type(const string& name);
+    // New instance with the default type
+    static SequenceCipher* create(const vector<octet>& key);
+
+    virtual ~SequenceCipher() {}
+
+    virtual void encrypt(octetStream& os, uint64_t counter) = 0;
+    virtual void decrypt(octetStream& os, uint64_t counter) = 0;
+};
+
+// octetStream::encrypt_sequence(), sending the nonce along
+class SecretboxSequenceCipher : public SequenceCipher
+{
+    vector<octet> key;
+
+public:
+    SecretboxSequenceCipher(const vector<octet>& key) : key(key) {}
+    ~SecretboxSequenceCipher();
+
+    void encrypt(octetStream& os, uint64_t counter);
+    void decrypt(octetStream& os, uint64_t counter);
+};
+
+/*
+ * AES-256-GCM as provided by libsodium using AES-NI and PCLMUL on
+ * several blocks at once. The key schedule is computed once, and
+ * only the tag is sent because the nonce follows from the counter.
+ */
+class AesGcmSequenceCipher : public SequenceCipher
+{
+    // needs more alignment than new guarantees
+    crypto_aead_aes256gcm_state* state;
+
+    static void nonce(octet* res, uint64_t counter);
+
+public:
+    AesGcmSequenceCipher(const vector<octet>& key);
+    ~AesGcmSequenceCipher();
+
+    void encrypt(octetStream& os, uint64_t counter);
+    void decrypt(octetStream& os, uint64_t counter);
+};
+
+#endif /* NETWORKING_SEQUENCECIPHER_H_ */
@@ -0,0 +1,210 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * ShmPlayer.cpp
+ *
+ */
+
+#include "Networking/ShmPlayer.h"
+#include "Exceptions/Exceptions.h"
+#include "Tools/int.h"
+
+#include <unistd.h>
+
+bool ShmPlayer::enabled = false;
+
+// One message with length header as over sockets,
+// progress() returns the number of bytes moved
+class ShmSend
+{
+    ShmPipe* pipe;
+    const octetStream* os;
+    octet header[LENGTH_SIZE];
+    size_t done;
+
+public:
+    ShmSend(ShmPipe* pipe, const octetStream& os) : pipe(pipe), os(&os), done(0)
+    {
+        encode_length(header, os.get_length(), LENGTH_SIZE);
+    }
+
+    bool complete() { return done == LENGTH_SIZE + os->get_length(); }
+
+    size_t progress()
+    {
+        size_t n = 0;
+        if (done < LENGTH_SIZE)
+            n += pipe->write_some((char*)header + done, LENGTH_SIZE - done);
+        done += n;
+        if (done >= LENGTH_SIZE and not complete())
+        {
+            size_t m = pipe->write_some(
+                    (char*)os->get_data() + done - LENGTH_SIZE,
+                    os->get_length() + LENGTH_SIZE - done);
+            done += m;
+            n += m;
+        }
+        if (n == 0 and pipe->consumer_gone())
+            throw runtime_error("other player has left shared memory");
+        if (complete())
+        {
+            sent_amount += done;
+            sent_counter++;
+        }
+        return n;
+    }
+};
+
+class ShmReceive
+{
+    ShmPipe* pipe;
+    octetStream* os;
+    octet header[LENGTH_SIZE];
+    size_t done, length;
+
+public:
+    ShmReceive(ShmPipe* pipe, octetStream& os) :
+            pipe(pipe), os(&os), done(0), length(0)
+    {
+    }
+
+    bool complete() { return done >= LENGTH_SIZE and done == LENGTH_SIZE + length; }
+
+    size_t progress()
+    {
+        size_t n = 0;
+        if (done < LENGTH_SIZE)
+        {
+            n = pipe->read_some((char*)header + done, LENGTH_SIZE - done);
+            done += n;
+            if (done == LENGTH_SIZE)
+            {
+                length = decode_length(header, LENGTH_SIZE);
+                os->reset_write_head();
+                os->append(length);
+            }
+        }
+        if (done >= LENGTH_SIZE and not complete())
+        {
+            size_t m = pipe->read_some(
+                    (char*)os->get_data() + done - LENGTH_SIZE,
+                    length + LENGTH_SIZE - done);
+            done += m;
+            n += m;
+        }
+        if (n == 0 and not complete() and pipe->producer_done())
+            throw runtime_error("other player has left shared memory");
+        return n;
+    }
+};
+
+ShmPlayer::ShmPlayer(const Names& Nms, int id_base) :
+        Player(Nms, id_base, true)
+{
+    out.resize(nplayers);
+    in.resize(nplayers);
+    vector<octetStream> names(nplayers);
+    for (int i = 0; i < nplayers; i++)
+    {
+        // unique for this process and instance
+        string name = "Player-" + to_string(getpid()) + "-"
+                + to_string(id_base) + "-" + to_string(player_no) + "-"
+                + to_string(i);
+        out[i] = ShmPipe::create(name);
+        if (out[i] == 0)
+            throw runtime_error("cannot create shared memory for " + name);
+        octetStream os;
+        os.append((octet*)name.data(), name.size());
+        Player::send_message(i, os);
+    }
+
+    for (int i = 0; i < nplayers; i++)
+    {
+        Player::receive_message(i, names[i]);
+        string name((char*)names[i].get_data(), names[i].get_length());
+        in[i] = ShmPipe::attach(name);
+        if (in[i] == 0)
+            throw runtime_error("cannot attach to shared memory of player "
+                    + to_string(i) + ", all players must be on the same host");
+    }
+}
+
+ShmPlayer::~ShmPlayer()
+{
+    for (int i = 0; i < nplayers; i++)
+    {
+        delete out[i];
+        delete in[i];
+    }
+}
+
+void ShmPlayer::send_message(int player, const octetStream& o) const
+{
+    ShmSend send(out[player], o);
+    int round = 0;
+    while (not send.complete())
+        if (send.progress())
+            round = 0;
+        else
+            ShmPipe::backoff(round);
+}
+
+void ShmPlayer::receive_message(int player, octetStream& o) const
+{
+    ShmReceive receive(in[player], o);
+    int round = 0;
+    while (not receive.complete())
+        if (receive.progress())
+            round = 0;
+        else
+            ShmPipe::backoff(round);
+}
+
+void ShmPlayer::transfer(const vector<const octetStream*>& sends,
+        const vector<octetStream*>& receives) const
+{
+    vector<ShmSend> pending_sends;
+    vector<ShmReceive> pending_receives;
+    for (int i = 0; i < nplayers; i++)
+    {
+        if (sends[i])
+            pending_sends.push_back(ShmSend(out[i], *sends[i]));
+        if (receives[i])
+            pending_receives.push_back(ShmReceive(in[i], *receives[i]));
+    }
+
+    int round = 0;
+    bool complete = false;
+    while (not complete)
+    {
+        complete = true;
+        size_t moved = 0;
+        for (auto& send : pending_sends)
+            if (not send.complete())
+            {
+                moved += send.progress();
+                complete &= send.complete();
+            }
+        for (auto& receive : pending_receives)
+            if (not receive.complete())
+            {
+                moved += receive.progress();
+                complete &= receive.complete();
+            }
+        if (moved)
+            round = 0;
+        else if (not complete)
+            ShmPipe::backoff(round);
+    }
+}
+
+void ShmPlayer::exchange(int other, octetStream& o) const
+{
+    send_receive(other, other, o);
+}
+
+void ShmPlayer::pass_around(octetStream& o, int offset) const
+{
+    send_receive(positive_modulo(player_no + offset, nplayers),
+            positive_modulo(player_no - offset, nplayers), o);
+}
@@ -0,0 +1,42 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * ShmPlayer.h
+ *
+ */
+
+#ifndef NETWORKING_SHMPLAYER_H_
+#define NETWORKING_SHMPLAYER_H_
+
+#include "Networking/Player.h"
+#include "Tools/ShmPipe.h"
+
+/*
+ * Player for parties on the same host, sending through a
+ * shared-memory ring per direction and pair of players instead of
+ * loopback TCP. The sockets are only used to exchange the names of
+ * the rings during setup.
+ */
+class ShmPlayer : public Player
+{
+    // rings written to and read from, indexed by player
+    vector<ShmPipe*> out, in;
+
+protected:
+    void send_message(int player, const octetStream& o) const;
+    void receive_message(int player, octetStream& o) const;
+    void transfer(const vector<const octetStream*>& sends,
+        const vector<octetStream*>& receives) const;
+
+public:
+    // Use this instead of the other players (-shm)
+    static bool enabled;
+
+    ShmPlayer(const Names& Nms, int id_base = 0);
+    ~ShmPlayer();
+
+    void exchange(int other, octetStream& o) const;
+    void pass_around(octetStream& o, int offset = 1) const;
+};
+
+#endif /* NETWORKING_SHMPLAYER_H_ */
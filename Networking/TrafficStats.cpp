@@ -0,0 +1,153 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * TrafficStats.cpp
+ *
+ */
+
+#include "Networking/TrafficStats.h"
+#include "Exceptions/Exceptions.h"
+
+#include <time.h>
+#include <fstream>
+
+bool TrafficStats::enabled = false;
+TrafficStats::ClassName TrafficStats::class_name = 0;
+
+void Histogram::add(unsigned long long x)
+{
+    int bucket = x ? 64 - __builtin_clzll(x) : 0;
+    counts[bucket]++;
+}
+
+void Histogram::print(ostream& os, const string& label,
+        const string& unit) const
+{
+    for (size_t i = 0; i < counts.size(); i++)
+        if (counts[i])
+            os << label << " < " << (1ull << min(i, (size_t) 63)) << " "
+                    << unit << ": " << counts[i] << endl;
+}
+
+void TrafficCounter::print(ostream& os) const
+{
+    os << "sent " << sent_bytes << " bytes in " << sent_messages
+            << " messages, received " << received_bytes << " bytes in "
+            << received_messages << " messages, waited " << wait
+            << " seconds" << endl;
+}
+
+double TrafficStats::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+TrafficStats::TrafficStats(int num_players, const string& filename) :
+        filename(filename), peers(num_players), tape("setup"), context(this),
+        instruction(-1)
+{
+}
+
+TrafficStats::~TrafficStats()
+{
+    ofstream file(filename.c_str());
+    print(file);
+    if (file.fail())
+        cerr << "Cannot write traffic statistics to " << filename << endl;
+    else
+        cerr << "Traffic statistics in " << filename << endl;
+}
+
+void TrafficStats::set_tape(const string& name)
+{
+    lock_guard<mutex> guard(lock);
+    tape = name;
+}
+
+void TrafficStats::follow(TrafficStats* other)
+{
+    context = other ? other : this;
+}
+
+void TrafficStats::add(TrafficCounter& counter, bool sent, long long bytes,
+        double wait)
+{
+    if (sent)
+    {
+        counter.sent_bytes += bytes;
+        counter.sent_messages++;
+    }
+    else
+    {
+        counter.received_bytes += bytes;
+        counter.received_messages++;
+        counter.wait += wait;
+    }
+}
+
+void TrafficStats::add(int player, bool sent, long long bytes, double wait)
+{
+    TrafficStats* context = this->context;
+    string tape;
+    {
+        lock_guard<mutex> guard(context->lock);
+        tape = context->tape;
+    }
+    lock_guard<mutex> guard(lock);
+    add(peers.at(player), sent, bytes, wait);
+    add(tapes[tape], sent, bytes, wait);
+    add(instruction_classes[context->instruction], sent, bytes, wait);
+    if (sent)
+        message_sizes.add(bytes);
+    else
+        waits.add(wait * 1e6);
+}
+
+void TrafficStats::sent(int player, size_t length)
+{
+    add(player, true, length, 0);
+}
+
+void TrafficStats::received(int player, size_t length, double start)
+{
+    add(player, false, length, now() - start);
+}
+
+void TrafficStats::print(ostream& os) const
+{
+    lock_guard<mutex> guard(lock);
+    for (size_t i = 0; i < peers.size(); i++)
+    {
+        os << "player " << i << ": ";
+        peers[i].print(os);
+    }
+    for (auto& x : tapes)
+        if (x.second.sent_messages or x.second.received_messages)
+        {
+            os << "tape " << x.first << ": ";
+            x.second.print(os);
+        }
+    // merge opcodes of the same class
+    map<string, TrafficCounter> classes;
+    for (auto& x : instruction_classes)
+    {
+        string name = "none";
+        if (x.first >= 0)
+            name = class_name ? class_name(x.first) : to_string(x.first);
+        TrafficCounter& counter = classes[name];
+        counter.sent_bytes += x.second.sent_bytes;
+        counter.sent_messages += x.second.sent_messages;
+        counter.received_bytes += x.second.received_bytes;
+        counter.received_messages += x.second.received_messages;
+        counter.wait += x.second.wait;
+    }
+    for (auto& x : classes)
+    {
+        os << "instructions " << x.first << ": ";
+        x.second.print(os);
+    }
+    message_sizes.print(os, "messages", "bytes");
+    waits.print(os, "waits", "microseconds");
+}
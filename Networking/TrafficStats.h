@@ -0,0 +1,95 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * TrafficStats.h
+ *
+ */
+
+#ifndef NETWORKING_TRAFFICSTATS_H_
+#define NETWORKING_TRAFFICSTATS_H_
+
+#include <vector>
+#include <map>
+#include <string>
+#include <iostream>
+#include <mutex>
+#include <atomic>
+using namespace std;
+
+// Counts in powers of two: bucket k holds values in [2^(k-1), 2^k)
+class Histogram
+{
+    vector<long long> counts;
+
+public:
+    Histogram() : counts(65) {}
+
+    void add(unsigned long long x);
+    void print(ostream& os, const string& label, const string& unit) const;
+};
+
+struct TrafficCounter
+{
+    long long sent_bytes, sent_messages;
+    long long received_bytes, received_messages;
+    // seconds spent waiting for receptions
+    double wait;
+
+    TrafficCounter() : sent_bytes(0), sent_messages(0), received_bytes(0),
+            received_messages(0), wait(0) {}
+
+    void print(ostream& os) const;
+};
+
+/*
+ * Traffic of one Player by peer, tape and instruction class
+ * with histograms of message sizes and waiting times.
+ * The processor sets the context, helper Players can follow the
+ * context of another. Written to a file on destruction.
+ * Thread-safe because the MAC check threads share Players.
+ */
+class TrafficStats
+{
+    string filename;
+    vector<TrafficCounter> peers;
+    map<string, TrafficCounter> tapes;
+    map<int, TrafficCounter> instruction_classes;
+    string tape;
+    atomic<TrafficStats*> context;
+    mutable mutex lock;
+
+    Histogram message_sizes;
+    // microseconds
+    Histogram waits;
+
+    void add(TrafficCounter& counter, bool sent, long long bytes, double wait);
+    void add(int player, bool sent, long long bytes, double wait);
+
+public:
+    // Collect statistics for every Player (-ts)
+    static bool enabled;
+
+    // Name of an instruction class given an opcode
+    typedef string (*ClassName)(int opcode);
+    static ClassName class_name;
+
+    static double now();
+
+    // Opcode of the current instruction, grouped by classes at the end
+    atomic<int> instruction;
+
+    TrafficStats(int num_players, const string& filename);
+    ~TrafficStats();
+
+    void set_tape(const string& name);
+    // Attribute traffic to the tape and instruction of other (0 for own)
+    void follow(TrafficStats* other);
+
+    void sent(int player, size_t length);
+    // start from now() before waiting
+    void received(int player, size_t length, double start);
+
+    void print(ostream& os) const;
+};
+
+#endif /* NETWORKING_TRAFFICSTATS_H_ */
@@ -5,6 +5,8 @@
 #include "Exceptions/Exceptions.h"
 #include "Tools/time-func.h"
 
+#include <fcntl.h>
+#include <poll.h>
 #include <iostream>
 using namespace std;
 
@@ -87,20 +89,9 @@ void close_server_socket(int consocket,int main_socket)
   if (close(main_socket)) { error("close(main_socket"); };
 }
 
-void set_up_client_socket(int& mysocket,const char* hostname,int Portnum)
+static void resolve(sockaddr_in& dest,const char* hostname,int Portnum)
 {
-   mysocket = socket(AF_INET, SOCK_STREAM, 0);
-   if (mysocket<0) { error("set_up_socket:socket");  }
-
-  /* disable Nagle's algorithm */
-  int one=1;
-  int fl= setsockopt(mysocket, IPPROTO_TCP, TCP_NODELAY, (char*)&one, sizeof(int));
-  if (fl<0) { error("set_up_socket:setsockopt");  }
-
-  fl=setsockopt(mysocket, SOL_SOCKET, SO_REUSEADDR, (char*)&one, sizeof(int));
-  if (fl<0) { error("set_up_socket:setsockopt"); }
-
-   struct sockaddr_in dest;
+   memset(&dest, 0, sizeof(dest));
    dest.sin_family = AF_INET;
    dest.sin_port = htons(Portnum);      // set destination port number
 
@@ -138,17 +129,120 @@ void set_up_client_socket(int& mysocket,const char* hostname,int Portnum)
            }
       }
    freeaddrinfo(ai);
+}
+
+// non-blocking socket with connection in progress,
+// returns false if refused straight away
+static bool start_connect(int& mysocket,const sockaddr_in& dest)
+{
+   mysocket = socket(AF_INET, SOCK_STREAM, 0);
+   if (mysocket<0) { error("set_up_socket:socket");  }
+
+  /* disable Nagle's algorithm */
+  int one=1;
+  int fl= setsockopt(mysocket, IPPROTO_TCP, TCP_NODELAY, (char*)&one, sizeof(int));
+  if (fl<0) { error("set_up_socket:setsockopt");  }
+
+  fl=setsockopt(mysocket, SOL_SOCKET, SO_REUSEADDR, (char*)&one, sizeof(int));
+  if (fl<0) { error("set_up_socket:setsockopt"); }
+
+  fcntl(mysocket, F_SETFL, fcntl(mysocket, F_GETFL) | O_NONBLOCK);
+  fl=connect(mysocket, (struct sockaddr *)&dest, sizeof(struct sockaddr));
+  if (fl==0 or errno==EINPROGRESS)
+    return true;
+  if (errno!=ECONNREFUSED)
+    { error("set_up_socket:connect"); }
+  close(mysocket);
+  mysocket=-1;
+  return false;
+}
 
+void set_up_client_socket(int& mysocket,const char* hostname,int Portnum)
+{
+  vector<int> sockets(1);
+  set_up_client_sockets(sockets, {hostname}, {Portnum});
+  mysocket = sockets[0];
+}
 
-   Timer timer;
-   timer.start();
-   do
-   {  fl=1;
-      while (fl==1 || errno==EINPROGRESS)
-       { fl=connect(mysocket, (struct sockaddr *)&dest, sizeof(struct sockaddr)); }
-   }
-   while (fl==-1 && errno==ECONNREFUSED && timer.elapsed() < 60);
-   if (fl<0) { error("set_up_socket:connect:",hostname);  }
+void set_up_client_sockets(vector<int>& sockets,const vector<string>& hostnames,const vector<int>& ports)
+{
+  size_t n = hostnames.size();
+  vector<sockaddr_in> dests(n);
+  for (size_t i = 0; i < n; i++)
+    resolve(dests[i], hostnames[i].c_str(), ports[i]);
+
+  // refused connections are retried after an increasing delay
+  // because the other side might not be listening yet
+  sockets.assign(n, -1);
+  vector<double> retry_at(n, 0), delay(n, 0.001);
+  vector<bool> connected(n, false);
+  Timer timer;
+  timer.start();
+  size_t n_connected = 0;
+  while (n_connected < n)
+    {
+      double now = timer.elapsed();
+      double next_retry = 1;
+      vector<struct pollfd> fds;
+      vector<size_t> indices;
+      for (size_t i = 0; i < n; i++)
+        {
+          if (connected[i])
+            continue;
+          if (sockets[i] < 0 and retry_at[i] <= now)
+            {
+              if (not start_connect(sockets[i], dests[i]))
+                {
+                  retry_at[i] = now + delay[i];
+                  delay[i] = min(2 * delay[i], 0.1);
+                }
+            }
+          if (sockets[i] >= 0)
+            {
+              fds.push_back({sockets[i], POLLOUT, 0});
+              indices.push_back(i);
+            }
+          else
+            next_retry = min(next_retry, retry_at[i] - now);
+        }
+
+      if (now > 60)
+        { errno = ETIMEDOUT;
+          error("set_up_socket:connect:", hostnames[indices.empty() ?
+            0 : indices[0]].c_str()); }
+
+      int res = poll(fds.data(), fds.size(), max(1, int(next_retry * 1000)));
+      if (res < 0 and errno != EINTR)
+        { error("set_up_socket:poll"); }
+
+      for (size_t j = 0; j < fds.size() and res > 0; j++)
+        {
+          if (fds[j].revents == 0)
+            continue;
+          size_t i = indices[j];
+          int err = 0;
+          socklen_t len = sizeof(err);
+          getsockopt(sockets[i], SOL_SOCKET, SO_ERROR, &err, &len);
+          if (err == 0)
+            {
+              fcntl(sockets[i], F_SETFL, fcntl(sockets[i], F_GETFL) & ~O_NONBLOCK);
+              connected[i] = true;
+              n_connected++;
+            }
+          else if (err == ECONNREFUSED)
+            {
+              close(sockets[i]);
+              sockets[i] = -1;
+              retry_at[i] = timer.elapsed() + delay[i];
+              delay[i] = min(2 * delay[i], 0.1);
+            }
+          else
+            {
+              errno = err;
+              error("set_up_socket:connect:", hostnames[i].c_str());
+            }
+        }
+    }
 }
 
 void close_client_socket(int socket)
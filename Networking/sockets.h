@@ -20,9 +20,12 @@
 
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>   /* Wait for Process Termination */
 
 #include <iostream>
+#include <string>
+#include <vector>
 using namespace std;
 
 
@@ -33,6 +36,8 @@ void set_up_server_socket(sockaddr_in& dest,int& consocket,int& main_socket,int
 void close_server_socket(int consocket,int main_socket);
 
 void set_up_client_socket(int& mysocket,const char* hostname,int Portnum);
+// Connect to all at once, retrying for a minute if refused
+void set_up_client_sockets(vector<int>& sockets,const vector<string>& hostnames,const vector<int>& ports);
 void close_client_socket(int socket);
 
 /* Send and receive 8 bit integers */
@@ -64,12 +69,49 @@ inline void send(int socket,octet *msg,size_t len)
   sent_counter++;
 }
 
+// Gathers several buffers in one system call where possible,
+// modifies iov on partial writes
+inline void send(int socket,struct iovec* iov,int iovcnt)
+{
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; i++)
+    total += iov[i].iov_len;
+
+  size_t done = 0;
+  while (done < total)
+    {
+      ssize_t j = writev(socket,iov,iovcnt);
+      if (j < 0)
+        {
+          if (errno != EINTR)
+            { error("Send error - 2 ");  }
+          continue;
+        }
+      done += j;
+      // skip what has been written
+      while (iovcnt > 0 and (size_t)j >= iov->iov_len)
+        {
+          j -= iov->iov_len;
+          iov++;
+          iovcnt--;
+        }
+      if (iovcnt > 0)
+        {
+          iov->iov_base = (char*)iov->iov_base + j;
+          iov->iov_len -= j;
+        }
+    }
+
+  sent_amount += total;
+  sent_counter++;
+}
+
 inline void receive(int socket,octet *msg,size_t len)
 {
   size_t i=0;
   int fail = 0;
   while (len-i>0)
-    { int j=recv(socket,msg+i,len-i,0);
+    { int j=recv(socket,msg+i,len-i,MSG_WAITALL);
       if (j<0)
         {
           if (errno == EAGAIN or errno == EINTR)
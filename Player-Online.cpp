@@ -1,6 +1,12 @@
 // (C) 2018 University of Bristol. See License.txt
 
 #include "Processor/Machine.h"
+#include "Processor/PreprocessingPlan.h"
+#include "Networking/EpollPlayer.h"
+#include "Networking/ShmPlayer.h"
+#include "Networking/ChannelPlayer.h"
+#include "Networking/EmulatedPlayer.h"
+#include "Networking/SequenceCipher.h"
 #include "Math/Setup.h"
 #include "Tools/ezOptionParser.h"
 #include "Tools/Config.h"
@@ -77,10 +83,11 @@ int main(int argc, const char** argv)
           0, // Required?
           1, // Number of args expected.
           0, // Delimiter if expecting multiple args.
-          "Where to obtain memory, new|old|empty (default: empty)\n\t"
+          "Where to obtain memory, new|old|empty|snapshot (default: empty)\n\t"
             "new: copy from Player-Memory-P<i> file\n\t"
             "old: reuse previous memory in Memory-P<i>\n\t"
-            "empty: create new empty memory", // Help description.
+            "empty: create new empty memory\n\t"
+            "snapshot: map binary Memory-P<i>.bin and update it at the end", // Help description.
           "-m", // Flag token.
           "--memory" // Flag token.
     );
@@ -120,6 +127,69 @@ int main(int argc, const char** argv)
           "-t", // Flag token.
           "--threads" // Flag token.
     );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Handle communication with all players in one event loop per thread (epoll)", // Help description.
+          "-e", // Flag token.
+          "--epoll" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Communicate through shared memory instead of TCP, all players on the same host", // Help description.
+          "-shm", // Flag token.
+          "--shared-memory" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Multiplex all threads over one connection per pair of players", // Help description.
+          "-ch", // Flag token.
+          "--channels" // Flag token.
+    );
+    opt.add(
+          "1", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Connections per pair of players for large messages, the same for all players (default: 1)", // Help description.
+          "-st", // Flag token.
+          "--stripes" // Flag token.
+    );
+    opt.add(
+          "1048576", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Split messages of at least this many bytes over the connections given by --stripes (default: 1048576)", // Help description.
+          "-stt", // Flag token.
+          "--stripe-threshold" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Emulate latency and bandwidth of the links described in a file, all players on the same host (see NETWORK.example)", // Help description.
+          "-ne", // Flag token.
+          "--network-emulation" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Count traffic by player, tape and instruction class with histograms of message sizes and waits, written to Traffic-P<player>-<id> in Player-Data", // Help description.
+          "-ts", // Flag token.
+          "--traffic-stats" // Flag token.
+    );
     opt.add(
           "0", // Default.
           0, // Required?
@@ -139,6 +209,95 @@ int main(int argc, const char** argv)
           "--player-to-player-commsec" // Flag token.
     );
 
+    opt.add(
+          "", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Keep running and execute programs requested on a local socket, "
+            "one 'PROGRAM [INPUT_DIR]' per line, 'quit' to stop. "
+            "INPUT_DIR replaces Player-Data for Private-Input-* and the "
+            "current directory for *_input_*.txt. The parties check "
+            "that they run the same programs in the same order.", // Help description.
+          "-cs", // Flag token.
+          "--control-socket" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Pin online threads and their communication threads to CPUs, core|node|<list>\n\t"
+            "core: one CPU per thread, filling NUMA nodes in order\n\t"
+            "node: one NUMA node per thread, round-robin\n\t"
+            "<list>: CPU lists per thread separated by ':', e.g. 0-7:8-15", // Help description.
+          "-a", // Flag token.
+          "--affinity" // Flag token.
+    );
+    opt.add(
+          "0", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Read preprocessed data ahead in background threads, n shares or tuples per block (default: 0, synchronous reading)", // Help description.
+          "-pf", // Flag token.
+          "--prefetch" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Map preprocessed data files into memory and decode directly from there", // Help description.
+          "-M", // Flag token.
+          "--mmap-preprocessing" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Read preprocessed data from offline processes on the same host started with --shm-pipe, falling back to files otherwise. Only for programs with one thread.", // Help description.
+          "-sp", // Flag token.
+          "--shm-pipe" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Compute the preprocessing needed by each schedule, write it to Plan-<program>-P<player> in the data directory, check the files and read them ahead", // Help description.
+          "-pl", // Flag token.
+          "--plan" // Flag token.
+    );
+    opt.add(
+          "blake2b", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Hash for checking broadcasts, blake2b or sha1, the same for all players (default: blake2b)", // Help description.
+          "-bh", // Flag token.
+          "--broadcast-hash" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Hash broadcast data in a helper thread", // Help description.
+          "-ht", // Flag token.
+          "--hash-thread" // Flag token.
+    );
+    opt.add(
+          "secretbox", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Cipher for the external client connections, secretbox or aes-gcm, the same for all players and clients (default: secretbox)", // Help description.
+          "-cc", // Flag token.
+          "--commsec-cipher" // Flag token.
+    );
+
     opt.parse(argc, argv);
 
     vector<string*> allArgs(opt.firstArgs);
@@ -184,7 +343,7 @@ int main(int argc, const char** argv)
       return 1;
     }
 
-    string memtype, hostname, ipFileName;
+    string memtype, hostname, ipFileName, control_socket, affinity;
     int lg2, lgp, pnbase, opening_sum, max_broadcast;
     int p2pcommsec;
     int my_port;
@@ -198,6 +357,29 @@ int main(int argc, const char** argv)
     opt.get("--opening-sum")->getInt(opening_sum);
     opt.get("--max-broadcast")->getInt(max_broadcast);
     opt.get("--player-to-player-commsec")->getInt(p2pcommsec);
+    opt.get("--control-socket")->getString(control_socket);
+    opt.get("--affinity")->getString(affinity);
+    opt.get("--prefetch")->getInt(BufferBase::prefetch_size);
+    BufferBase::use_mmap = opt.get("--mmap-preprocessing")->isSet;
+    BufferBase::use_shm_pipe = opt.get("--shm-pipe")->isSet;
+    PreprocessingPlan::enabled = opt.get("--plan")->isSet;
+    string broadcast_hash;
+    opt.get("--broadcast-hash")->getString(broadcast_hash);
+    BroadcastHash::default_type = BroadcastHash::parse_type(broadcast_hash);
+    BroadcastHash::use_thread = opt.get("--hash-thread")->isSet;
+    string commsec_cipher;
+    opt.get("--commsec-cipher")->getString(commsec_cipher);
+    SequenceCipher::default_type = SequenceCipher::parse_type(commsec_cipher);
+    EpollPlayer::enabled = opt.get("--epoll")->isSet;
+    ShmPlayer::enabled = opt.get("--shared-memory")->isSet;
+    ChannelPlayer::enabled = opt.get("--channels")->isSet;
+    int stripe_threshold;
+    opt.get("--stripes")->getInt(Stripes::count);
+    opt.get("--stripe-threshold")->getInt(stripe_threshold);
+    Stripes::threshold = stripe_threshold;
+    opt.get("--network-emulation")->getString(NetworkEmulation::filename);
+    TrafficStats::enabled = opt.get("--traffic-stats")->isSet;
+    TrafficStats::class_name = Instruction::class_name;
 
     ez::OptionGroup* mp_opt = opt.get("--my-port");
     if (mp_opt->isSet)
@@ -232,9 +414,13 @@ int main(int argc, const char** argv)
     try
 #endif
     {
-        Machine(playerno, playerNames, progname, memtype, lgp, lg2,
+        Machine machine(playerno, playerNames, progname, memtype, lgp, lg2,
                 opt.get("--direct")->isSet, opening_sum, opt.get("--parallel")->isSet,
-                opt.get("--threads")->isSet, max_broadcast).run();
+                opt.get("--threads")->isSet, max_broadcast, affinity);
+        if (control_socket.empty())
+            machine.run();
+        else
+            machine.serve(control_socket);
 
         cerr << "Command line:";
         for (int i = 0; i < argc; i++)
@@ -9,7 +9,138 @@
 #include "Processor/InputTuple.h"
 #include "Processor/Data_Files.h"
 
-bool BufferBase::rewind = false;
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+atomic<bool> BufferBase::rewind(false);
+int BufferBase::prefetch_size = 0;
+bool BufferBase::use_mmap = false;
+bool BufferBase::use_shm_pipe = false;
+
+BufferPrefetcher::BufferPrefetcher(BufferBase& buffer, string type_string,
+        size_t block_size, int n_blocks) :
+        buffer(buffer), type_string(type_string), blocks(n_blocks),
+        current(0), pos(0)
+{
+    start = buffer.file->tellg();
+    for (auto& block : blocks)
+    {
+        block.data.resize(block_size);
+        free_blocks.push(&block);
+    }
+    pthread_create(&thread, 0, run, this);
+}
+
+BufferPrefetcher::~BufferPrefetcher()
+{
+    free_blocks.stop();
+    pthread_join(thread, 0);
+}
+
+void* BufferPrefetcher::run(void* prefetcher)
+{
+    BufferPrefetcher& self = *(BufferPrefetcher*)prefetcher;
+    PrefetchBlock* block;
+    while (self.free_blocks.pop(block))
+    {
+        self.fill(*block);
+        self.full_blocks.push(block);
+        // nothing to read after a problem
+        if (block->error)
+            break;
+    }
+    return 0;
+}
+
+void BufferPrefetcher::fill(PrefetchBlock& block)
+{
+    ifstream* file = buffer.file;
+    block.size = 0;
+    block.start = file->tellg();
+    block.rewound = false;
+    block.error = exception_ptr();
+    try
+    {
+        do
+        {
+            file->read(block.data.data() + block.size,
+                    block.data.size() - block.size);
+            block.size += file->gcount();
+            if (file->eof())
+            {
+                buffer.rewind_file();
+                block.start = -1;
+                block.rewound = true;
+            }
+            if (file->fail())
+              {
+                stringstream ss;
+                ss << "IO problem when buffering " << type_string;
+                if (buffer.data_type)
+                  ss << " " << buffer.data_type;
+                ss << " from " << buffer.filename;
+                throw file_error(ss.str());
+              }
+        }
+        while (block.size < block.data.size());
+    }
+    catch (...)
+    {
+        // passed on when the data before is used up
+        block.error = current_exception();
+    }
+}
+
+void BufferPrefetcher::read(char* dest, size_t size)
+{
+    while (size > 0)
+    {
+        if (current == 0 or pos == current->size)
+        {
+            if (current)
+            {
+                if (current->error)
+                    rethrow_exception(current->error);
+                free_blocks.push(current);
+            }
+            full_blocks.pop(current);
+            pos = 0;
+            if (current->rewound)
+                buffer.eof = BufferBase::rewind = true;
+            continue;
+        }
+
+        size_t n = min(size, current->size - pos);
+        memcpy(dest, current->data.data() + pos, n);
+        dest += n;
+        size -= n;
+        pos += n;
+    }
+}
+
+long BufferPrefetcher::tellg()
+{
+    if (current == 0)
+        return start;
+    else if (current->start < 0)
+        return -1;
+    else
+        return current->start + pos;
+}
+
+bool BufferPrefetcher::seekg(long offset)
+{
+    if (current and current->start >= 0 and offset >= current->start
+            and offset <= long(current->start + current->size))
+    {
+        pos = offset - current->start;
+        return true;
+    }
+    else
+        return false;
+}
 
 
 void BufferBase::setup(ifstream* f, int length, string filename,
@@ -20,21 +151,172 @@ void BufferBase::setup(ifstream* f, int length, string filename,
     data_type = type;
     field_type = field;
     this->filename = filename;
+    if (use_mmap)
+        map();
+}
+
+void BufferBase::set_packing(int component_size, int packed_component_size)
+{
+    this->component_size = component_size;
+    this->packed_component_size = packed_component_size;
+}
+
+// Zero-extend compact field elements. With padding, src may be read
+// up to eight bytes beyond the data, which allows fixed-size loads
+// that the compiler can vectorize.
+static void unpack(char* dest, const char* src, int n, int full, int packed,
+        bool padded)
+{
+    if (padded and full == 8)
+    {
+        uint64_t mask = packed == 8 ? ~0ull : (1ull << (8 * packed)) - 1;
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t x;
+            memcpy(&x, src + i * packed, 8);
+            x &= mask;
+            memcpy(dest + i * 8, &x, 8);
+        }
+    }
+    else
+        for (int i = 0; i < n; i++)
+        {
+            memcpy(dest + i * full, src + i * packed, packed);
+            memset(dest + i * full + packed, 0, full - packed);
+        }
+}
+
+void BufferBase::map()
+{
+    unmap();
+    offset = 0;
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    // empty or missing files are left to the stream to report
+    if (fstat(fd, &st) == 0 and st.st_size > 0)
+    {
+        void* data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            mapping = (char*)data;
+            mapping_size = st.st_size;
+        }
+    }
+    ::close(fd);
+}
+
+void BufferBase::unmap()
+{
+    if (mapping)
+        munmap(mapping, mapping_size);
+    mapping = 0;
+    mapping_size = 0;
+}
+
+void BufferBase::attach_pipe()
+{
+    if (not use_shm_pipe or file == 0 or pipe != 0)
+        return;
+    pipe = ShmPipe::attach(filename);
+    if (pipe)
+    {
+        cerr << "Reading " << filename << " from shared memory" << endl;
+        unmap();
+    }
+}
+
+int BufferBase::read_pipe(char* read_buffer, int size)
+{
+    long start = pipe->bytes_read();
+    int n_read = pipe->read(read_buffer, size);
+    pipe_start = start;
+    pipe_block = size;
+    if (n_read < size)
+    {
+        cerr << "Producer of " << filename
+                << " has finished, continuing from file" << endl;
+        pipe_bytes = start + n_read;
+        pipe_block = 0;
+        delete pipe;
+        pipe = 0;
+    }
+    return n_read;
+}
+
+void BufferBase::close()
+{
+    stop_prefetch();
+    unmap();
+    delete pipe;
+    pipe = 0;
 }
 
 void BufferBase::seekg(int pos)
 {
-    file->seekg(pos * tuple_length);
+    next = BUFFER_SIZE;
+    if (pipe)
+    {
+        long target = (long)pos * tuple_length;
+        // within the last block
+        if (pipe_block > 0 and target >= pipe_start
+                and target < pipe_start + pipe_block)
+        {
+            next = (target - pipe_start) / (pipe_block / BUFFER_SIZE);
+            return;
+        }
+        long current = pipe->bytes_read();
+        if (target < current)
+            throw runtime_error("cannot seek backwards in shared memory for "
+                    + filename);
+        pipe_block = 0;
+        if (pipe->skip(target - current) == size_t(target - current))
+            return;
+        pipe_bytes = pipe->bytes_read();
+        delete pipe;
+        pipe = 0;
+    }
+    long file_offset = (long)pos * tuple_length - pipe_bytes;
+    if (file_offset < 0)
+        throw runtime_error("cannot seek back into shared memory data for "
+                + filename);
+    if (mapping)
+    {
+        offset = file_offset;
+        // let it go in case we don't need it anyway
+        if (offset > mapping_size)
+        {
+            try_rewind();
+            offset = 0;
+        }
+        return;
+    }
+    if (prefetcher)
+    {
+        if (prefetcher->seekg(file_offset))
+            return;
+        stop_prefetch();
+    }
+
+    file->seekg(file_offset);
     if (file->eof() || file->fail())
     {
         // let it go in case we don't need it anyway
-        if (pos != 0)
+        if (file_offset != 0)
             try_rewind();
     }
-    next = BUFFER_SIZE;
 }
 
 void BufferBase::try_rewind()
+{
+    rewind_file();
+    rewind = true;
+    eof = true;
+}
+
+void BufferBase::rewind_file()
 {
 #ifndef INSECURE
     string type;
@@ -48,27 +330,92 @@ void BufferBase::try_rewind()
         throw runtime_error("empty file: " + filename);
     if (!rewind)
         cerr << "REWINDING - ONLY FOR BENCHMARKING" << endl;
-    rewind = true;
-    eof = true;
+}
+
+void BufferBase::read_prefetched(char* read_buffer, int size, int element_size,
+        string type_string)
+{
+    if (not prefetcher)
+        prefetcher = new BufferPrefetcher(*this, type_string,
+                prefetch_size * element_size);
+    prefetcher->read(read_buffer, size);
+}
+
+void BufferBase::stop_prefetch()
+{
+    if (prefetcher)
+    {
+        // continue where consumption stopped
+        long pos = prefetcher->tellg();
+        delete prefetcher;
+        prefetcher = 0;
+        file->clear();
+        if (pos >= 0)
+            file->seekg(pos);
+    }
 }
 
 void BufferBase::prune()
 {
+    stop_prefetch();
+    // nothing taken from the file yet
+    if (pipe)
+        return;
+    if (mapping)
+    {
+        if (offset != 0)
+        {
+            cerr << "Pruning " << filename << endl;
+            string tmp_name = filename + ".new";
+            int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+                throw file_error(tmp_name);
+            size_t done = offset;
+            while (done < mapping_size)
+            {
+                ssize_t res = write(fd, mapping + done, mapping_size - done);
+                if (res < 0)
+                {
+                    ::close(fd);
+                    unlink(tmp_name.c_str());
+                    throw file_error(tmp_name);
+                }
+                done += res;
+            }
+            // keep the original unless the copy is complete
+            if (::close(fd) != 0 or rename(tmp_name.c_str(), filename.c_str()) != 0)
+            {
+                unlink(tmp_name.c_str());
+                throw file_error(tmp_name);
+            }
+            file->close();
+            file->open(filename.c_str(), ios::in | ios::binary);
+            map();
+        }
+        return;
+    }
     if (file and file->tellg() != 0)
     {
         cerr << "Pruning " << filename << endl;
         string tmp_name = filename + ".new";
         ofstream tmp(tmp_name.c_str());
-        tmp << file->rdbuf();
+        // inserting nothing would set the failbit
+        if (file->peek() != EOF)
+            tmp << file->rdbuf();
         tmp.close();
+        if (tmp.fail() or rename(tmp_name.c_str(), filename.c_str()) != 0)
+        {
+            unlink(tmp_name.c_str());
+            throw file_error(tmp_name);
+        }
         file->close();
-        rename(tmp_name.c_str(), filename.c_str());
         file->open(filename.c_str(), ios::in | ios::binary);
     }
 }
 
 void BufferBase::purge()
 {
+    close();
     if (file)
     {
         cerr << "Removing " << filename << endl;
@@ -81,6 +428,7 @@ void BufferBase::purge()
 template<class T, class U>
 Buffer<T, U>::~Buffer()
 {
+    close();
     if (timer.elapsed() && data_type)
         cerr << T::type_string() << " " << data_type << " reading: "
                 << timer.elapsed() << endl;
@@ -89,7 +437,18 @@ Buffer<T, U>::~Buffer()
 template<class T, class U>
 void Buffer<T, U>::fill_buffer()
 {
-  if (T::size() == sizeof(T))
+  if (packed_component_size)
+    {
+      char packed_buffer[sizeof(buffer) + 8];
+      read(packed_buffer);
+      char read_buffer[sizeof(buffer)];
+      unpack(read_buffer, packed_buffer,
+          BUFFER_SIZE * T::size() / component_size, component_size,
+          packed_component_size, true);
+      for (int i = 0; i < BUFFER_SIZE; i++)
+        buffer[i].assign(&read_buffer[i*T::size()]);
+    }
+  else if (T::size() == sizeof(T))
     {
       // read directly
       read((char*)buffer);
@@ -107,9 +466,25 @@ void Buffer<T, U>::fill_buffer()
 template<class T, class U>
 void Buffer<T, U>::read(char* read_buffer)
 {
-    int size_in_bytes = T::size() * BUFFER_SIZE;
+    int size_in_bytes = file_size() * BUFFER_SIZE;
     int n_read = 0;
     timer.start();
+    if (pipe)
+    {
+        n_read = read_pipe(read_buffer, size_in_bytes);
+        if (n_read == size_in_bytes)
+        {
+            timer.stop();
+            return;
+        }
+    }
+    if (prefetch_size > 0)
+    {
+        read_prefetched(read_buffer + n_read, size_in_bytes - n_read,
+                file_size(), T::type_string());
+        timer.stop();
+        return;
+    }
     do
     {
         file->read(read_buffer + n_read, size_in_bytes - n_read);
@@ -135,6 +510,23 @@ void Buffer<T, U>::read(char* read_buffer)
 template <class T, class U>
 void Buffer<T,U>::input(U& a)
 {
+    if (mapping)
+    {
+        // same state as decoding into a fresh buffer entry
+        a.assign_zero();
+        if (packed_component_size)
+        {
+            char read_buffer[sizeof(T)];
+            unpack(read_buffer, next_mapped(file_size()),
+                    T::size() / component_size, component_size,
+                    packed_component_size, false);
+            a.assign(read_buffer);
+        }
+        else
+            a.assign(next_mapped(T::size()));
+        return;
+    }
+
     if (next == BUFFER_SIZE)
     {
         fill_buffer();
@@ -159,14 +551,27 @@ BufferBase& BufferHelper<U,V>::get_buffer(DataFieldType field_type)
 template < template<class T> class U, template<class T> class V >
 void BufferHelper<U,V>::setup(DataFieldType field_type, string filename, int tuple_length, const char* data_type)
 {
+    BufferBase& buffer = get_buffer(field_type);
+    if (Data_Files::use_packed(filename, tuple_length, field_type))
+        buffer.set_packing(Data_Files::component_size(field_type),
+                Data_Files::packed_component_size(field_type));
     files[field_type] = new ifstream(filename.c_str(), ios::in | ios::binary);
-    get_buffer(field_type).setup(files[field_type], tuple_length, filename,
+    buffer.setup(files[field_type], tuple_length, filename,
             data_type, Data_Files::long_field_names[field_type]);
 }
 
+template<template<class T> class U, template<class T> class V>
+void BufferHelper<U,V>::attach_pipes()
+{
+    buffer2.attach_pipe();
+    bufferp.attach_pipe();
+}
+
 template<template<class T> class U, template<class T> class V>
 void BufferHelper<U,V>::close()
 {
+    buffer2.close();
+    bufferp.close();
     for (int i = 0; i < N_DATA_FIELD_TYPE; i++)
         if (files[i])
         {
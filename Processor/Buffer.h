@@ -9,21 +9,70 @@
 #define PROCESSOR_BUFFER_H_
 
 #include <fstream>
+#include <vector>
+#include <exception>
+#include <atomic>
 using namespace std;
 
 #include "Math/Share.h"
 #include "Math/field_types.h"
 #include "Tools/time-func.h"
+#include "Tools/WaitQueue.h"
+#include "Tools/ShmPipe.h"
 
 #ifndef BUFFER_SIZE
 #define BUFFER_SIZE 101
 #endif
 
 
+class BufferBase;
+
+// Raw data read ahead from a file
+struct PrefetchBlock
+{
+    vector<char> data;
+    size_t size;
+    // file offset of the data, -1 if rewound in between
+    long start;
+    bool rewound;
+    exception_ptr error;
+};
+
+// Reads blocks ahead of consumption in a background thread
+class BufferPrefetcher
+{
+    BufferBase& buffer;
+    string type_string;
+    WaitQueue<PrefetchBlock*> free_blocks, full_blocks;
+    vector<PrefetchBlock> blocks;
+    pthread_t thread;
+
+    PrefetchBlock* current;
+    size_t pos;
+    long start;
+
+    static void* run(void* prefetcher);
+    void fill(PrefetchBlock& block);
+
+public:
+    BufferPrefetcher(BufferBase& buffer, string type_string, size_t block_size,
+            int n_blocks = 2);
+    ~BufferPrefetcher();
+
+    void read(char* dest, size_t size);
+    // file offset of the next byte to be consumed, -1 if unknown
+    long tellg();
+    // move within the current block if possible
+    bool seekg(long offset);
+};
+
 class BufferBase
 {
+    friend class BufferPrefetcher;
+
 protected:
-    static bool rewind;
+    // shared by all online and prefetching threads
+    static atomic<bool> rewind;
 
     ifstream* file;
     int next;
@@ -32,17 +81,68 @@ protected:
     Timer timer;
     int tuple_length;
     string filename;
+    BufferPrefetcher* prefetcher;
+
+    // whole file when mapped
+    char* mapping;
+    size_t mapping_size;
+    size_t offset;
+
+    // stream from a co-located producer, see ShmPipe
+    ShmPipe* pipe;
+    // pipe offset and length of the last block read
+    long pipe_start;
+    int pipe_block;
+    // data taken from the pipe before continuing with the file
+    long pipe_bytes;
+
+    // field element sizes in memory and in a compact file, 0 if not compact
+    int component_size;
+    int packed_component_size;
+
+    void rewind_file();
+    void read_prefetched(char* read_buffer, int size, int element_size,
+            string type_string);
+
+    int read_pipe(char* read_buffer, int size);
+
+    void map();
+    void unmap();
+    const char* next_mapped(int size)
+    {
+        if (offset + size > mapping_size)
+        {
+            try_rewind();
+            offset = 0;
+        }
+        const char* res = mapping + offset;
+        offset += size;
+        return res;
+    }
 
 public:
+    // Number of elements to read ahead per block, 0 for synchronous reading
+    static int prefetch_size;
+    // Decode straight from memory-mapped files
+    static bool use_mmap;
+    // Read from shared memory pipes where offline producers are running
+    static bool use_shm_pipe;
+
     bool eof;
 
     BufferBase() : file(0), next(BUFFER_SIZE), data_type(0), field_type(0),
-            tuple_length(-1), eof(false) {}
+            tuple_length(-1), prefetcher(0), mapping(0), mapping_size(0),
+            offset(0), pipe(0), pipe_start(0), pipe_block(0), pipe_bytes(0),
+            component_size(0), packed_component_size(0), eof(false) {}
     void setup(ifstream* f, int length, string filename, const char* type = 0,
             const char* field = 0);
+    void set_packing(int component_size, int packed_component_size);
     void seekg(int pos);
     bool is_up() { return file != 0; }
     void try_rewind();
+    void attach_pipe();
+    void stop_prefetch();
+    void close();
     void prune();
     void purge();
 };
@@ -53,6 +153,15 @@ class Buffer : public BufferBase
 {
     T buffer[BUFFER_SIZE];
 
+    // bytes per item in the file
+    int file_size()
+    {
+        if (packed_component_size)
+            return T::size() / component_size * packed_component_size;
+        else
+            return T::size();
+    }
+
     void read(char* read_buffer);
 
 public:
@@ -75,6 +184,7 @@ public:
     void input(V<gf2n>& a) { buffer2.input(a); }
     BufferBase& get_buffer(DataFieldType field_type);
     void setup(DataFieldType field_type, string filename, int tuple_length, const char* data_type = 0);
+    void attach_pipes();
     void close();
     void prune();
     void purge();
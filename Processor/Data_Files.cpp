@@ -4,7 +4,10 @@
 #include "Processor/Data_Files.h"
 #include "Processor/Processor.h"
 
+#include "Tools/int.h"
+
 #include <iomanip>
+#include <unistd.h>
 
 const char* Data_Files::field_names[] = { "p", "2" };
 const char* Data_Files::long_field_names[] = { "gfp", "gf2n" };
@@ -13,6 +16,7 @@ const bool Data_Files::implemented[N_DATA_FIELD_TYPE][N_DTYPE] = {
     { true, true, true, true, true, true },
 };
 const int Data_Files::tuple_size[N_DTYPE] = { 3, 2, 1, 2, 3, 3 };
+const char* Data_Files::PACKED_SUFFIX = ".packed";
 
 Lock Data_Files::tuple_lengths_lock;
 map<DataTag, int> Data_Files::tuple_lengths;
@@ -93,13 +97,90 @@ int Data_Files::tuple_length(int field_type, int dtype)
   return tuple_size[dtype] * share_length(field_type);
 }
 
+int Data_Files::component_size(int field_type)
+{
+  return share_length(field_type) / 2;
+}
+
+int Data_Files::packed_component_size(int field_type)
+{
+  switch (field_type)
+  {
+    case DATA_MODP:
+      // Montgomery representation is below the modulus as well
+      return numBytes(gfp::pr());
+    case DATA_GF2N:
+      return DIV_CEIL(gf2n::degree(), 8);
+    default:
+      throw invalid_params();
+  }
+}
+
+bool Data_Files::use_packed(string& filename, int& tuple_length, int field_type)
+{
+  string packed_name = filename + PACKED_SUFFIX;
+  // pipes and the files they fall back to are always full width
+  if (BufferBase::use_shm_pipe or access(packed_name.c_str(), F_OK) != 0)
+    return false;
+  filename = packed_name;
+  tuple_length = tuple_length / component_size(field_type)
+      * packed_component_size(field_type);
+  return true;
+}
+
+void Data_Files::pack_file(const string& filename, int field_type)
+{
+  int full = component_size(field_type);
+  int packed = packed_component_size(field_type);
+  string packed_name = filename + PACKED_SUFFIX;
+  ifstream inpf(filename.c_str(), ios::in | ios::binary);
+  ofstream outf(packed_name.c_str(), ios::out | ios::binary);
+  if (inpf.fail())
+    throw file_error(filename);
+  if (outf.fail())
+    throw file_error(packed_name);
+  vector<char> in(4096 * full), out(4096 * packed);
+  while (inpf)
+    {
+      inpf.read(in.data(), in.size());
+      size_t n = inpf.gcount();
+      if (n % full != 0)
+        throw file_error("incomplete field element in " + filename);
+      for (size_t i = 0; i < n / full; i++)
+        memcpy(&out[i * packed], &in[i * full], packed);
+      outf.write(out.data(), n / full * packed);
+    }
+  outf.close();
+  if (outf.fail())
+    throw file_error(packed_name);
+  unlink(filename.c_str());
+}
+
+string Data_Files::get_filename(const string& prep_data_dir, int field_type,
+    int dtype, int my_num)
+{
+  stringstream ss;
+  ss << prep_data_dir << dtype_names[dtype] << "-" << field_names[field_type]
+      << "-P" << my_num;
+  return ss.str();
+}
+
+string Data_Files::get_input_filename(const string& prep_data_dir,
+    int field_type, int my_num, int player)
+{
+  stringstream ss;
+  ss << prep_data_dir << "Inputs-" << field_names[field_type] << "-P"
+      << my_num << "-" << player;
+  return ss.str();
+}
+
 Data_Files::Data_Files(int myn, int n, const string& prep_data_dir) :
     usage(n), prep_data_dir(prep_data_dir)
 {
   cerr << "Setting up Data_Files in: " << prep_data_dir << endl;
   num_players=n;
   my_num=myn;
-  char filename[1024];
+  string filename;
   input_buffers = new BufferHelper<Share, Share>[num_players];
 
   for (int field_type = 0; field_type < N_DATA_FIELD_TYPE; field_type++)
@@ -108,8 +189,7 @@ Data_Files::Data_Files(int myn, int n, const string& prep_data_dir) :
         {
           if (implemented[field_type][dtype])
             {
-              sprintf(filename,(prep_data_dir + "%s-%s-P%d").c_str(),dtype_names[dtype],
-                  field_names[field_type],my_num);
+              filename = get_filename(prep_data_dir, field_type, dtype, my_num);
                 buffers[dtype].setup(DataFieldType(field_type), filename,
                         tuple_length(field_type, dtype), dtype_names[dtype]);
             }
@@ -117,8 +197,7 @@ Data_Files::Data_Files(int myn, int n, const string& prep_data_dir) :
 
       for (int i=0; i<num_players; i++)
         {
-          sprintf(filename,(prep_data_dir + "Inputs-%s-P%d-%d").c_str(),
-              field_names[field_type],my_num,i);
+          filename = get_input_filename(prep_data_dir, field_type, my_num, i);
           if (i == my_num)
                 my_input_buffers.setup(DataFieldType(field_type), filename,
                         share_length(field_type) * 3 / 2);
@@ -174,6 +253,15 @@ void Data_Files::skip(const DataPositions& pos)
   seekg(new_pos);
 }
 
+void Data_Files::attach_pipes()
+{
+  for (auto& buffer : buffers)
+    buffer.attach_pipes();
+  my_input_buffers.attach_pipes();
+  for (int i = 0; i < num_players; i++)
+    input_buffers[i].attach_pipes();
+}
+
 void Data_Files::prune()
 {
   for (auto& buffer : buffers)
@@ -181,7 +269,7 @@ void Data_Files::prune()
   my_input_buffers.prune();
   for (int j = 0; j < num_players; j++)
     input_buffers[j].prune();
-  for (auto it : extended)
+  for (auto& it : extended)
     it.second.prune();
 }
 
@@ -192,7 +280,7 @@ void Data_Files::purge()
   my_input_buffers.purge();
   for (int j = 0; j < num_players; j++)
     input_buffers[j].purge();
-  for (auto it : extended)
+  for (auto& it : extended)
     it.second.purge();
 }
 
@@ -86,6 +86,21 @@ class Data_Files
 
   static int share_length(int field_type);
   static int tuple_length(int field_type, int dtype);
+  static string get_filename(const string& prep_data_dir, int field_type,
+      int dtype, int my_num);
+  static string get_input_filename(const string& prep_data_dir,
+      int field_type, int my_num, int player);
+
+  // Compact format: every field element stored in as many bytes as
+  // the modulus needs, in a file with PACKED_SUFFIX appended to the name
+  static const char* PACKED_SUFFIX;
+  static int component_size(int field_type);
+  static int packed_component_size(int field_type);
+  // Switch to the compact file if it exists and no pipes are used,
+  // adjusting the tuple length
+  static bool use_packed(string& filename, int& tuple_length, int field_type);
+  // Convert a file to the compact format, removing the original
+  static void pack_file(const string& filename, int field_type);
 
   Data_Files(int my_num,int n,const string& prep_data_dir);
   Data_Files(Names& N, const string& prep_data_dir) :
@@ -95,6 +110,8 @@ class Data_Files
   DataPositions tellg();
   void seekg(DataPositions& pos);
   void skip(const DataPositions& pos);
+  // read from offline producers running on the same host if possible
+  void attach_pipes();
   void prune();
   void purge();
 
@@ -31,16 +31,7 @@ ExternalClients::~ExternalClients()
   {
     delete[] it->second;
   }
-  for (map<int, pair<vector<octet>,uint64_t> >::iterator it_cs = symmetric_client_commsec_send_keys.begin();
-    it_cs != symmetric_client_commsec_send_keys.end(); it_cs++)
-  {
-    memset(&(it_cs->second.first[0]), 0, it_cs->second.first.size());
-  }
-  for (map<int, pair<vector<octet>,uint64_t> >::iterator it_cs = symmetric_client_commsec_recv_keys.begin();
-    it_cs != symmetric_client_commsec_recv_keys.end(); it_cs++)
-  {
-    memset(&(it_cs->second.first[0]), 0, it_cs->second.first.size());
-  }
+  // the ciphers erase their keys
 }
 
 void ExternalClients::start_listening(int portnum_base)
@@ -5,9 +5,11 @@
 
 #include "Networking/ServerSocket.h"
 #include "Networking/sockets.h"
+#include "Networking/SequenceCipher.h"
 #include "Exceptions/Exceptions.h"
 #include <vector>
 #include <map>
+#include <memory>
 #include <iostream>
 #include <fstream>
 #include <sodium.h>
@@ -38,8 +40,9 @@ class ExternalClients
   // Maps holding per client values (indexed by unique 32-bit id)
   std::map<int,int> external_client_sockets;
   std::map<int,octet*> symmetric_client_keys;
-  std::map<int,pair<vector<octet>,uint64_t>> symmetric_client_commsec_send_keys;
-  std::map<int,pair<vector<octet>,uint64_t>> symmetric_client_commsec_recv_keys;
+  // Ciphers set up from the keys agreed with STS, and message counters
+  std::map<int,pair<shared_ptr<SequenceCipher>,uint64_t>> symmetric_client_commsec_send_keys;
+  std::map<int,pair<shared_ptr<SequenceCipher>,uint64_t>> symmetric_client_commsec_recv_keys;
 
   ExternalClients(int party_num, const string& prep_data_dir);
   ~ExternalClients();
@@ -36,6 +36,8 @@ struct RefInputTuple
   T& value;
   RefInputTuple(Share<T>& share, T& value) : share(share), value(value) {}
   void operator=(InputTuple<T>& other) { share = other.share; value = other.value; }
+  void assign_zero() { share.assign_zero(); value.assign_zero(); }
+  void assign(const char* buffer) { share.assign(buffer); value.assign(buffer + Share<T>::size()); }
 };
 
 
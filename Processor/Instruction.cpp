@@ -350,21 +350,9 @@ void BaseInstruction::parse_operands(istream& s, int pos)
         n = get_int(s);
         break;
       case REQBL:
-        n = get_int(s);
-        if (n > 0 && gfp::pr() < bigint(1) << (n-1))
-          {
-            cout << "Tape requires prime of bit length " << n << endl;
-            throw invalid_params();
-          }
-        break;
       case GREQBL:
         n = get_int(s);
-        if (n > 0 && gf2n::degree() < int(n))
-          {
-            stringstream ss;
-            ss << "Tape requires prime of bit length " << n << endl;
-            throw Processor_Error(ss.str());
-          }
+        check_requirements();
         break;
       case E_INPUT_SHARE_INT:
       case GE_INPUT_SHARE_INT:
@@ -401,6 +389,61 @@ void BaseInstruction::parse_operands(istream& s, int pos)
 }
 
 
+void BaseInstruction::check_requirements() const
+{
+  switch (opcode)
+  {
+    case REQBL:
+      if (n > 0 && gfp::pr() < bigint(1) << (n-1))
+        {
+          cout << "Tape requires prime of bit length " << n << endl;
+          throw invalid_params();
+        }
+      break;
+    case GREQBL:
+      if (n > 0 && gf2n::degree() < int(n))
+        {
+          stringstream ss;
+          ss << "Tape requires prime of bit length " << n << endl;
+          throw Processor_Error(ss.str());
+        }
+      break;
+  }
+}
+
+
+/* The flat representation is
+ *   opcode size r[0] r[1] r[2] r[3] n len(start) start[0] ...
+ */
+void BaseInstruction::flatten(vector<int>& res) const
+{
+  res.push_back(opcode);
+  res.push_back(size);
+  res.insert(res.end(), r, r + 4);
+  res.push_back(n);
+  res.push_back(start.size());
+  res.insert(res.end(), start.begin(), start.end());
+}
+
+const int* BaseInstruction::unflatten(const int* data, const int* end)
+{
+  if (end - data < 8)
+    return 0;
+  opcode = *data++;
+  size = *data++;
+  for (int i = 0; i < 4; i++)
+    r[i] = *data++;
+  n = *data++;
+  int n_start = *data++;
+  if (n_start < 0 or n_start > end - data)
+    return 0;
+  start.assign(data, data + n_start);
+  data += n_start;
+  check_requirements();
+  return data;
+}
+
+
 bool Instruction::get_offline_data_usage(DataPositions& usage)
 {
   switch (opcode)
@@ -518,6 +561,21 @@ bool BaseInstruction::is_direct_memory_access(SecrecyType sec_type) const
 
 
 
+string BaseInstruction::class_name(int opcode)
+{
+  static const char* names[] = { "load/store", "machine", "addition",
+      "multiplication", "extension multiplication", "data access", "input",
+      "bitwise logic", "bitwise shifts", "branching and integers", "open",
+      "IO", "conversion", "load/store", "other", "other" };
+  string res;
+  if (opcode & 0x100)
+    res = "gf2n ";
+  if (opcode >= 0x200)
+    return res + "extension";
+  return res + names[(opcode >> 4) & 0xF];
+}
+
+
 ostream& operator<<(ostream& s,const Instruction& instr)
 {
   s << instr.opcode << " : ";
@@ -569,7 +627,70 @@ void Instruction::execute(Processor& Proc) const
       for (int i = 0; i < size; i++)
          Proc.get_S2_ref(r[0] + i).mul(Proc.read_S2(r[1] + i),Proc.read_C2(r[2] + i));
       return;
+    case LDMC:
+      Proc.load_C(r[0], Proc.machine.Mp, n, size);
+      return;
+    case GLDMC:
+      Proc.load_C(r[0], Proc.machine.M2, n, size);
+      return;
+    case LDMS:
+      Proc.load_S(r[0], Proc.machine.Mp, n, size);
+      return;
+    case GLDMS:
+      Proc.load_S(r[0], Proc.machine.M2, n, size);
+      return;
+    case STMC:
+      Proc.store_C(r[0], Proc.machine.Mp, n, size);
+      return;
+    case GSTMC:
+      Proc.store_C(r[0], Proc.machine.M2, n, size);
+      return;
+    case STMS:
+      Proc.store_S(r[0], Proc.machine.Mp, n, size);
+      return;
+    case GSTMS:
+      Proc.store_S(r[0], Proc.machine.M2, n, size);
+      return;
   }
+
+  // gather and scatter with evenly spaced addresses
+  long base, stride;
+  if (size > 1)
+    switch (opcode)
+    {
+      case LDMCI:
+        if (Proc.get_stride(r[1], size, base, stride))
+          return Proc.load_C(r[0], Proc.machine.Mp, base, size, stride);
+        break;
+      case GLDMCI:
+        if (Proc.get_stride(r[1], size, base, stride))
+          return Proc.load_C(r[0], Proc.machine.M2, base, size, stride);
+        break;
+      case LDMSI:
+        if (Proc.get_stride(r[1], size, base, stride))
+          return Proc.load_S(r[0], Proc.machine.Mp, base, size, stride);
+        break;
+      case GLDMSI:
+        if (Proc.get_stride(r[1], size, base, stride))
+          return Proc.load_S(r[0], Proc.machine.M2, base, size, stride);
+        break;
+      case STMCI:
+        if (Proc.get_stride(r[1], size, base, stride))
+          return Proc.store_C(r[0], Proc.machine.Mp, base, size, stride);
+        break;
+      case GSTMCI:
+        if (Proc.get_stride(r[1], size, base, stride))
+          return Proc.store_C(r[0], Proc.machine.M2, base, size, stride);
+        break;
+      case STMSI:
+        if (Proc.get_stride(r[1], size, base, stride))
+          return Proc.store_S(r[0], Proc.machine.Mp, base, size, stride);
+        break;
+      case GSTMSI:
+        if (Proc.get_stride(r[1], size, base, stride))
+          return Proc.store_S(r[0], Proc.machine.M2, base, size, stride);
+        break;
+    }
 #endif
 
   int r[3] = {this->r[0], this->r[1], this->r[2]};
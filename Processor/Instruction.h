@@ -320,12 +320,23 @@ public:
   void parse_operands(istream& s, int pos);
 
   bool is_gf2n_instruction() const { return ((opcode&0x100)!=0); }
+  int get_opcode() const { return opcode; }
+  // Group of instructions as in the list of opcodes
+  static string class_name(int opcode);
   virtual int get_reg_type() const;
 
   bool is_direct_memory_access(SecrecyType sec_type) const;
 
   // Returns the maximal register used
   int get_max_reg(int reg_type) const;
+
+  // Throws if the current fields do not satisfy the requirements
+  void check_requirements() const;
+
+  // Flat representation for the decoded-tape cache
+  void flatten(vector<int>& res) const;
+  // 0 if the instruction does not fit before end
+  const int* unflatten(const int* data, const int* end);
 };
 
 
@@ -7,20 +7,26 @@
 #include <sys/time.h>
 
 #include "Math/Setup.h"
+#include "Networking/ControlSocket.h"
+#include "Processor/PreprocessingPlan.h"
 
 #include <iostream>
 #include <vector>
 #include <string>
+#include <sstream>
+#include <algorithm>
 #include <fstream>
 #include <pthread.h>
 using namespace std;
 
 Machine::Machine(int my_number, Names& playerNames,
     string progname_str, string memtype, int lgp, int lg2, bool direct,
-    int opening_sum, bool parallel, bool receive_threads, int max_broadcast)
+    int opening_sum, bool parallel, bool receive_threads, int max_broadcast,
+    string affinity)
   : my_number(my_number), N(playerNames), nthreads(0), tn(0), numt(0), usage_unknown(false),
-    progname(progname_str), direct(direct), opening_sum(opening_sum), parallel(parallel),
-    receive_threads(receive_threads), max_broadcast(max_broadcast)
+    snapshot(0), query(0), direct(direct), opening_sum(opening_sum), parallel(parallel),
+    receive_threads(receive_threads), max_broadcast(max_broadcast),
+    affinity(affinity)
 {
   if (opening_sum < 2)
     this->opening_sum = N.num_players();
@@ -75,37 +81,88 @@ Machine::Machine(int my_number, Names& playerNames,
        inpf >> M2 >> Mp >> Mi;
        inpf.close();
      }
+  else if (memtype.compare("snapshot")==0)
+     {
+       sprintf(filename, PREP_DIR "Memory-P%d.bin", my_number);
+       snapshot = new MemorySnapshot(filename);
+       snapshot->load(M2, Mp, Mi);
+     }
   else if (!(memtype.compare("empty")==0))
      { cerr << "Invalid memory argument" << endl;
        exit(1);
      }
 
+  // Keep record of used offline data
+  pos.set_num_players(N.num_players());
+
+  load_schedule(progname_str);
+
+  // positions in a pipe cannot be shared with other threads' files
+  if (BufferBase::use_shm_pipe and nthreads > 1)
+    throw runtime_error("--shm-pipe requires a program with one thread, "
+        + progname + " has " + to_string(nthreads));
+
+  /* Set up the threads */
+  tinfo.resize(nthreads);
+  threads.resize(nthreads);
+  join_timer.resize(nthreads);
+
+  for (int i=0; i<nthreads; i++)
+    { tinfo[i].thread_num=i;
+      tinfo[i].Nms=&N;
+      tinfo[i].alphapi=&alphapi;
+      tinfo[i].alpha2i=&alpha2i;
+      tinfo[i].jobs=new WaitQueue<tape_job>;
+      tinfo[i].machine=this;
+      pthread_create(&threads[i],NULL,Main_Func,&tinfo[i]);
+    }
+
+  // synchronize with clients before starting timer
+  for (int i=0; i<nthreads; i++)
+    {
+      cerr << "Waiting for thread " << i << " to be ready" << endl;
+      tinfo[i].ready.get_future().wait();
+    }
+}
+
+void Machine::load_schedule(const string& progname)
+{
+  this->progname = progname;
+  if (inpf.is_open())
+    inpf.close();
+  char filename[1024];
   sprintf(filename, "Programs/Schedules/%s.sch",progname.c_str());
   cerr << "Opening file " << filename << endl;
   inpf.open(filename);
   if (inpf.fail()) { throw file_error("Missing '" + string(filename) + "'. Did you compile '" + progname + "'?"); }
 
-  int nprogs;
+  int nprogs, nthreads;
   inpf >> nthreads;
   inpf >> nprogs;
 
-  // Keep record of used offline data
-  pos.set_num_players(N.num_players());
-
   cerr << "Number of threads I will run in parallel = " << nthreads << endl;
   cerr << "Number of program sequences I need to load = " << nprogs << endl;
 
+  // Threads are only started once
+  if (this->nthreads == 0)
+    this->nthreads = nthreads;
+  else if (nthreads > this->nthreads)
+    {
+      inpf.close();
+      throw Processor_Error(progname + " needs " + to_string(nthreads)
+          + " threads but only " + to_string(this->nthreads) + " are running");
+    }
+
   // Load in the programs 
+  progs.clear();
   progs.resize(nprogs,N.num_players());
   char threadname[1024];
   for (int i=0; i<nprogs; i++)
     { inpf >> threadname;
       sprintf(filename,"Programs/Bytecode/%s.bc",threadname);
       cerr << "Loading program " << i << " from " << filename << endl;
-      ifstream pinp(filename);
-      if (pinp.fail()) { throw file_error(filename); }
-      progs[i].parse(pinp);
-      pinp.close();
+      progs[i].parse(filename);
+      progs[i].name = threadname;
       M2.minimum_size(GF2N, progs[i], threadname);
       Mp.minimum_size(MODP, progs[i], threadname);
       Mi.minimum_size(INT, progs[i], threadname);
@@ -113,40 +170,21 @@ Machine::Machine(int my_number, Names& playerNames,
 
   progs[0].print_offline_cost();
 
-  /* Set up the threads */
-  tinfo.resize(nthreads);
-  threads.resize(nthreads);
-  t_mutex.resize(nthreads);
-  client_ready.resize(nthreads);
-  server_ready.resize(nthreads);
-  join_timer.resize(nthreads);
-
-  for (int i=0; i<nthreads; i++)
-    { pthread_mutex_init(&t_mutex[i],NULL);
-      pthread_cond_init(&client_ready[i],NULL);
-      pthread_cond_init(&server_ready[i],NULL);
-      tinfo[i].thread_num=i;
-      tinfo[i].Nms=&N;
-      tinfo[i].alphapi=&alphapi;
-      tinfo[i].alpha2i=&alpha2i;
-      tinfo[i].prognum=-2;  // Dont do anything until we are ready
-      tinfo[i].finished=true;
-      tinfo[i].ready=false;
-      tinfo[i].machine=this;
-      // lock for synchronization
-      pthread_mutex_lock(&t_mutex[i]);
-      pthread_create(&threads[i],NULL,Main_Func,&tinfo[i]);
-    }
-
-  // synchronize with clients before starting timer
-  for (int i=0; i<nthreads; i++)
+  if (PreprocessingPlan::enabled)
     {
-      while (!tinfo[i].ready)
-        {
-          cerr << "Waiting for thread " << i << " to be ready" << endl;
-          pthread_cond_wait(&client_ready[i],&t_mutex[i]);
-        }
-      pthread_mutex_unlock(&t_mutex[i]);
+      PreprocessingPlan plan(N.num_players());
+      plan.add_schedule(progname, progs);
+      plan.print(cerr);
+      plan.write(prep_dir_prefix + "Plan-" + progname + "-P"
+          + to_string(my_number));
+      // fail before running anything unless data may be reused or
+      // comes from offline processes running alongside
+#ifdef INSECURE
+      bool fail = false;
+#else
+      bool fail = not BufferBase::use_shm_pipe;
+#endif
+      plan.prepare_files(prep_dir_prefix, my_number, pos, fail);
     }
 }
 
@@ -156,14 +194,14 @@ DataPositions Machine::run_tape(int thread_number, int tape_number, int arg, int
     throw Processor_Error("invalid thread number: " + to_string(thread_number) + "/" + to_string(tinfo.size()));
   if (tape_number >= (int)progs.size())
     throw Processor_Error("invalid tape number: " + to_string(tape_number) + "/" + to_string(progs.size()));
-  pthread_mutex_lock(&t_mutex[thread_number]);
-  tinfo[thread_number].prognum=tape_number;
-  tinfo[thread_number].arg=arg;
-  tinfo[thread_number].pos=pos;
-  tinfo[thread_number].finished=false;
+  tape_job job;
+  job.prognum=tape_number;
+  job.arg=arg;
+  job.pos=pos;
+  job.done.reset(new promise<void>);
+  tinfo[thread_number].finished=job.done->get_future();
   //printf("Send signal to run program %d in thread %d\n",tape_number,thread_number);
-  pthread_cond_signal(&server_ready[thread_number]);
-  pthread_mutex_unlock(&t_mutex[thread_number]);
+  tinfo[thread_number].jobs->push(job);
   //printf("Running line %d\n",exec);
   if (progs[tape_number].usage_unknown())
     { // only one thread allowed
@@ -192,11 +230,10 @@ DataPositions Machine::run_tape(int thread_number, int tape_number, int arg, int
 void Machine::join_tape(int i)
 {
   join_timer[i].start();
-  pthread_mutex_lock(&t_mutex[i]);
   //printf("Waiting for client to terminate\n");
-  if ((tinfo[i].finished)==false)
-    { pthread_cond_wait(&client_ready[i],&t_mutex[i]); }
-  pthread_mutex_unlock(&t_mutex[i]);
+  // rethrows any exception from the tape
+  if (tinfo[i].finished.valid())
+    tinfo[i].finished.get();
   join_timer[i].stop();
 }
 
@@ -206,6 +243,12 @@ void Machine::run()
   proc_timer.start();
   timer[0].start();
 
+  run_schedule();
+  finish(proc_timer);
+}
+
+void Machine::run_schedule()
+{
   bool flag=true;
   usage_unknown=false;
   int exec=0;
@@ -251,33 +294,140 @@ void Machine::run()
 //    cerr << "Compiler: " << compiler << endl;
   // statistics comment out (end)
   inpf.close();
+  query++;
+}
 
-  finish_timer.start();
-  // Tell all C-threads to stop
-  for (int i=0; i<nthreads; i++)
-    { pthread_mutex_lock(&t_mutex[i]);
-	//printf("Send kill signal to client\n");
-        tinfo[i].prognum=-1;
-        tinfo[i].ready = false;
-        pthread_cond_signal(&server_ready[i]);
-      pthread_mutex_unlock(&t_mutex[i]);
+// Everyone's value in order of player numbers
+static vector<string> broadcast_string(const Player& P, const string& value)
+{
+  vector<octetStream> os(P.num_players());
+  os[P.my_num()].append((octet*)value.data(), value.size());
+  P.Broadcast_Receive(os, true);
+  vector<string> res;
+  for (auto& o : os)
+    res.push_back(string((char*)o.get_data(), o.get_length()));
+  return res;
+}
+
+void Machine::serve(const string& control_socket)
+{
+  Timer proc_timer(CLOCK_PROCESS_CPUTIME_ID);
+  proc_timer.start();
+  timer[0].start();
+
+  // Requests are agreed on with the other parties before running
+  // anything, otherwise they would wait for tapes that never start.
+  // The threads' players are busy with tapes, hence another one.
+  Player P(N, nthreads << 16);
+  // clients may send requests at any time
+  P.set_timeout(0);
+
+  // the program given on the command line has been loaded already
+  bool loaded = true;
+  ControlSocket control(control_socket);
+  while (true)
+    {
+      // "PROGRAM [INPUT_DIR]", the input directory may differ per party
+      string request, name;
+      if (not control.get_request(request))
+        request = "quit";
+      stringstream ss(request);
+      ss >> name;
+      input_dir.clear();
+      ss >> input_dir;
+
+      vector<string> names = broadcast_string(P, name);
+      if (count(names.begin(), names.end(), "quit"))
+        {
+          // all parties stop as soon as one does
+          control.reply(name == "quit" ? "OK" : "ERROR another party quit");
+          break;
+        }
+      if (count(names.begin(), names.end(), name) != (int)names.size())
+        {
+          control.reply("ERROR the parties requested different programs");
+          continue;
+        }
+
+      string load_error;
+      try
+        {
+          if (not loaded or name != progname)
+            load_schedule(name);
+        }
+      catch (exception& e)
+        {
+          if (inpf.is_open())
+            inpf.close();
+          load_error = string("ERROR ") + e.what();
+        }
+      // everything is reloaded after a failure or a run
+      loaded = false;
+
+      vector<string> errors = broadcast_string(P, load_error);
+      if (not load_error.empty())
+        {
+          control.reply(load_error);
+          continue;
+        }
+      if (count(errors.begin(), errors.end(), "") != (int)errors.size())
+        {
+          control.reply("ERROR loading " + name + " failed at another party");
+          continue;
+        }
+
+      Timer query_timer;
+      query_timer.start();
+      try
+        {
+          run_schedule();
+        }
+      catch (exception& e)
+        {
+          // the parties are out of step after a failed tape
+          control.reply(string("ERROR ") + e.what());
+          throw;
+        }
+      control.reply("OK " + to_string(query_timer.elapsed()));
     }
+
+  finish(proc_timer);
+}
+
+Machine::~Machine()
+{
+  stop_threads();
+}
+
+void Machine::stop_threads()
+{
+  // Tell all C-threads to stop
+  for (unsigned i=0; i<threads.size(); i++)
+    tinfo[i].jobs->stop();
   // statistics comment out (start)
 //  cerr << "Waiting for all clients to finish" << endl;
   // statistics comment out (end)
   // Wait until all clients have signed out
-  for (int i=0; i<nthreads; i++)
+  for (unsigned i=0; i<threads.size(); i++)
     {
-      pthread_mutex_lock(&t_mutex[i]);
-      tinfo[i].ready = true;
-      pthread_cond_signal(&server_ready[i]);
-      pthread_mutex_unlock(&t_mutex[i]);
       pthread_join(threads[i],NULL);
-      pthread_mutex_destroy(&t_mutex[i]);
-      pthread_cond_destroy(&client_ready[i]);
-      pthread_cond_destroy(&server_ready[i]);
+      delete tinfo[i].jobs;
     }
+  threads.clear();
+}
+
+void Machine::finish(Timer& proc_timer)
+{
+  finish_timer.start();
+  stop_threads();
   finish_timer.stop();
+
+  if (snapshot)
+    {
+      snapshot->save(M2, Mp, Mi);
+      delete snapshot;
+      snapshot = 0;
+    }
   
 
   for (unsigned int i = 0; i < join_timer.size(); i++)
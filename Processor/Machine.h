@@ -9,6 +9,7 @@
 #define MACHINE_H_
 
 #include "Processor/Memory.h"
+#include "Processor/MemorySnapshot.h"
 #include "Processor/Program.h"
 
 #include "Processor/Online-Thread.h"
@@ -16,6 +17,7 @@
 #include "Math/gfp.h"
 
 #include "Tools/time-func.h"
+#include "Tools/Affinity.h"
 
 #include <vector>
 #include <map>
@@ -35,10 +37,10 @@ public:
 
 class Machine : public BaseMachine
 {
-  /* The mutex's lock the C-threads and then only release
-   * then we an MPC thread is ready to run on the C-thread.
-   * Control is passed back to the main loop when the
-   * MPC thread releases the mutex
+  /* Each C-thread takes MPC threads (tapes) from its own job queue.
+   * Tapes stay bound to the thread number given by the schedule
+   * because thread i only talks to thread i of the other parties.
+   * Completion is signalled through the future of the last job.
    */
 
   vector<thread_info> tinfo;
@@ -59,16 +61,20 @@ class Machine : public BaseMachine
   int tn,numt;
   bool usage_unknown;
 
+  void run_schedule();
+  // Stop and join all threads unless done already
+  void stop_threads();
+  void finish(Timer& proc_timer);
+
   public:
 
-  vector<pthread_mutex_t> t_mutex;
-  vector<pthread_cond_t>  client_ready;
-  vector<pthread_cond_t>  server_ready;
   vector<Program>  progs;
 
   Memory<gf2n> M2;
   Memory<gfp> Mp;
   Memory<Integer> Mi;
+  // Only with binary snapshots (-m snapshot)
+  MemorySnapshot* snapshot;
 
   vector<Timer> join_timer;
   Timer finish_timer;
@@ -76,19 +82,34 @@ class Machine : public BaseMachine
   string prep_dir_prefix;
   string progname;
 
+  // Number of schedules run so far
+  int query;
+  // Directory with the private inputs of the current query,
+  // the default locations if empty
+  string input_dir;
+
   bool direct;
   int opening_sum;
   bool parallel;
   bool receive_threads;
   int max_broadcast;
+  CpuAffinity affinity;
 
   Machine(int my_number, Names& playerNames, string progname,
       string memtype, int lgp, int lg2, bool direct, int opening_sum, bool parallel,
-      bool receive_threads, int max_broadcast);
+      bool receive_threads, int max_broadcast, string affinity = "");
+  // Stops the threads if a query failed
+  ~Machine();
 
   DataPositions run_tape(int thread_number, int tape_number, int arg, int line_number);
   void join_tape(int thread_number);
+
+  void load_schedule(const string& progname);
   void run();
+
+  // Run programs as requested on a local socket until "quit",
+  // each request must be the same at all parties
+  void serve(const string& control_socket);
 };
 
 #endif /* MACHINE_H_ */
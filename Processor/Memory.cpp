@@ -5,8 +5,249 @@
 #include "Math/gf2n.h"
 #include "Math/gfp.h"
 #include "Math/Integer.h"
+#include "Exceptions/Exceptions.h"
 
 #include <fstream>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+template<class V>
+MemoryPages<V>::~MemoryPages()
+{
+  resize(0);
+  unmap();
+}
+
+template<class V>
+V* MemoryPages<V>::new_zeros(size_t size)
+{
+  // default constructors do not necessarily clear everything
+  V* res = new V[size];
+  for (size_t i = 0; i < size; i++)
+    res[i].assign_zero();
+  return res;
+}
+
+template<class V>
+const V& MemoryPages<V>::zero()
+{
+  static const V* res = new_zeros(1);
+  return *res;
+}
+
+template<class V>
+V* MemoryPages<V>::allocate(size_t page)
+{
+  V* res = new_zeros(PAGE_SIZE);
+  V* expected = 0;
+  if (not pages[page].compare_exchange_strong(expected, res,
+      memory_order_acq_rel, memory_order_acquire))
+    {
+      // another thread was faster
+      delete[] res;
+      res = expected;
+    }
+  return res;
+}
+
+template<class V>
+void MemoryPages<V>::resize(size_t size)
+{
+  size_t new_n_pages = (size + PAGE_SIZE - 1) >> PAGE_BITS;
+  if (size < n)
+    {
+      for (size_t i = new_n_pages; i < n_pages; i++)
+        if (not is_mapped(pages[i].load()))
+          delete[] pages[i].load();
+      // clear the rest of the last page in case it is used again
+      if (size & (PAGE_SIZE - 1))
+        {
+          V* page = pages[size >> PAGE_BITS].load();
+          if (page)
+            for (size_t i = size & (PAGE_SIZE - 1); i < PAGE_SIZE; i++)
+              page[i].assign_zero();
+        }
+    }
+  if (new_n_pages != n_pages)
+    {
+      atomic<V*>* new_pages = 0;
+      atomic<bool>* new_dirty = 0;
+      if (new_n_pages)
+        {
+          new_pages = new atomic<V*>[new_n_pages];
+          new_dirty = new atomic<bool>[new_n_pages];
+        }
+      for (size_t i = 0; i < new_n_pages; i++)
+        {
+          new_pages[i] = i < n_pages ? pages[i].load() : 0;
+          new_dirty[i] = i < n_pages ? dirty[i].load() : false;
+        }
+      delete[] pages;
+      delete[] dirty;
+      pages = new_pages;
+      dirty = new_dirty;
+      n_pages = new_n_pages;
+      intact = false;
+    }
+  n = size;
+}
+
+template<class V>
+void MemoryPages<V>::unmap()
+{
+  if (mapping)
+    munmap(mapping, mapped_pages * PAGE_SIZE * sizeof(V));
+  mapping = 0;
+  mapped_pages = 0;
+  intact = false;
+}
+
+template<class V>
+void MemoryPages<V>::map(int fd, off_t offset, size_t size)
+{
+  resize(0);
+  unmap();
+  resize(size);
+  intact = true;
+  if (n_pages == 0)
+    return;
+
+  void* data = mmap(0, file_length(), PROT_READ | PROT_WRITE, MAP_PRIVATE,
+      fd, offset);
+  if (data == MAP_FAILED)
+    throw file_error("cannot map memory snapshot: " + string(strerror(errno)));
+  mapping = (V*)data;
+  mapped_pages = n_pages;
+  for (size_t i = 0; i < n_pages; i++)
+    {
+      pages[i] = mapping + i * PAGE_SIZE;
+      dirty[i] = false;
+    }
+}
+
+template<class V>
+void MemoryPages<V>::save(int fd, off_t offset, bool only_dirty)
+{
+  size_t page_length = PAGE_SIZE * sizeof(V);
+  for (size_t i = 0; i < n_pages; i++)
+    {
+      V* page = pages[i].load();
+      if (page and (dirty[i] or not only_dirty))
+        {
+          char* data = (char*)page;
+          size_t done = 0;
+          while (done < page_length)
+            {
+              ssize_t res = pwrite(fd, data + done, page_length - done,
+                  offset + i * page_length + done);
+              if (res < 0)
+                throw file_error("cannot write memory snapshot: " + string(strerror(errno)));
+              done += res;
+            }
+        }
+      dirty[i] = false;
+    }
+}
+
+template<class V>
+void MemoryPages<V>::read(V* dest, size_t start, size_t size, long stride) const
+{
+  if (stride != 1)
+    {
+      for (size_t i = 0; i < size; i++)
+        dest[i] = (*this)[start + i * stride];
+      return;
+    }
+
+  while (size > 0)
+    {
+      size_t offset = start & (PAGE_SIZE - 1);
+      size_t n = min(size, PAGE_SIZE - offset);
+      V* page = pages[start >> PAGE_BITS].load(memory_order_acquire);
+      if (page)
+        memcpy((void*)dest, (void*)(page + offset), n * sizeof(V));
+      else
+        for (size_t i = 0; i < n; i++)
+          dest[i] = zero();
+      dest += n;
+      start += n;
+      size -= n;
+    }
+}
+
+template<class V>
+void MemoryPages<V>::write(const V* source, size_t start, size_t size, long stride)
+{
+  if (stride != 1)
+    {
+      for (size_t i = 0; i < size; i++)
+        get(start + i * stride) = source[i];
+      return;
+    }
+
+  while (size > 0)
+    {
+      size_t offset = start & (PAGE_SIZE - 1);
+      size_t n = min(size, PAGE_SIZE - offset);
+      memcpy((void*)&get(start), (void*)source, n * sizeof(V));
+      source += n;
+      start += n;
+      size -= n;
+    }
+}
+
+template<class V>
+void check_range(const MemoryPages<V>& M, long start, int size, long stride)
+{
+  if (size <= 0)
+    return;
+  long last = start + (size - 1) * stride;
+  if (start < 0 or last < 0 or start >= (long)M.size() or last >= (long)M.size())
+    throw Processor_Error("memory access out of range: " + to_string(start)
+        + " to " + to_string(last) + "/" + to_string(M.size()));
+}
+
+template<class T>
+void Memory<T>::read_C_range(long start, T* dest, int size, long stride) const
+{
+  check_range(MC, start, size, stride);
+  MC.read(dest, start, size, stride);
+}
+
+template<class T>
+void Memory<T>::read_S_range(long start, Share<T>* dest, int size, long stride) const
+{
+  check_range(MS, start, size, stride);
+  MS.read(dest, start, size, stride);
+}
+
+template<class T>
+void Memory<T>::write_C_range(long start, const T* source, int size, long stride, int PC)
+{
+  check_range(MC, start, size, stride);
+  MC.write(source, start, size, stride);
+  (void)PC;
+#ifdef MEMPROTECT
+  for (int i = 0; i < size; i++)
+    if (is_protected_c(start + i * stride))
+      cerr << "Protected clear memory access of " << start + i * stride << " by " << PC - 1 << endl;
+#endif
+}
+
+template<class T>
+void Memory<T>::write_S_range(long start, const Share<T>* source, int size, long stride, int PC)
+{
+  check_range(MS, start, size, stride);
+  MS.write(source, start, size, stride);
+  (void)PC;
+#ifdef MEMPROTECT
+  for (int i = 0; i < size; i++)
+    if (is_protected_s(start + i * stride))
+      cerr << "Protected secret memory access of " << start + i * stride << " by " << PC - 1 << endl;
+#endif
+}
 
 template<class T>
 void Memory<T>::minimum_size(RegType reg_type, const Program& program, string threadname)
@@ -99,10 +340,10 @@ istream& operator>>(istream& s,Memory<T>& M)
   s.seekg(1, istream::cur);
 
   for (unsigned int i=0; i<M.MS.size(); i++)
-    { M.MS[i].input(s,false);  }
+    { M.MS.get(i).input(s,false);  }
 
   for (unsigned int i=0; i<M.MC.size(); i++)
-    { M.MC[i].input(s,false); }
+    { M.MC.get(i).input(s,false); }
 
   return s;
 }
@@ -142,6 +383,13 @@ void Load_Memory(Memory<T>& M,ifstream& inpf)
     }
 }
 
+template class MemoryPages< Share<gfp> >;
+template class MemoryPages< Share<gf2n> >;
+template class MemoryPages< Share<Integer> >;
+template class MemoryPages<gfp>;
+template class MemoryPages<gf2n>;
+template class MemoryPages<Integer>;
+
 template class Memory<gfp>;
 template class Memory<gf2n>;
 template class Memory<Integer>;
@@ -159,6 +407,8 @@ template void Load_Memory(Memory<gf2n>& M,ifstream& inpf);
 template void Load_Memory(Memory<Integer>& M,ifstream& inpf);
 
 #ifdef USE_GF2N_LONG
+template class MemoryPages< Share<gf2n_short> >;
+template class MemoryPages<gf2n_short>;
 template class Memory<gf2n_short>;
 template istream& operator>>(istream& s,Memory<gf2n_short>& M);
 template ostream& operator<<(ostream& s,const Memory<gf2n_short>& M);
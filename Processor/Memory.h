@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <set>
+#include <atomic>
 using namespace std;
 
 // Forward declaration as apparently this is needed for friends in templates
@@ -16,11 +17,82 @@ template<class T> istream& operator>>(istream& s,Memory<T>& M);
 
 #include "Processor/Program.h"
 #include "Math/Share.h"
+
+/* Address space split into fixed-size pages that are only allocated
+ * on first write, reading an untouched entry returns zero.
+ * Pages are published atomically so that several threads can write
+ * concurrently, but resizing requires that no thread is running.
+ * Pages can also come from a copy-on-write file mapping, in which
+ * case writes are tracked per page.
+ */
+template<class V>
+class MemoryPages
+{
+  atomic<V*>* pages;
+  atomic<bool>* dirty;
+  size_t n_pages;
+  size_t n;
+
+  V* mapping;
+  size_t mapped_pages;
+  bool intact;
+
+  // prevent copying
+  MemoryPages(const MemoryPages& other);
+
+  static V* new_zeros(size_t size);
+  static const V& zero();
+  V* allocate(size_t page);
+  bool is_mapped(V* page) const
+    { return page >= mapping and page < mapping + mapped_pages * PAGE_SIZE; }
+  void unmap();
+
+  public:
+
+  static const int PAGE_BITS = 10;
+  static const size_t PAGE_SIZE = 1 << PAGE_BITS;
+
+  MemoryPages() : pages(0), dirty(0), n_pages(0), n(0), mapping(0),
+      mapped_pages(0), intact(false) {}
+  ~MemoryPages();
+
+  size_t size() const { return n; }
+  void resize(size_t size);
+
+  const V& operator[](size_t i) const
+    { V* page = pages[i >> PAGE_BITS].load(memory_order_acquire);
+      if (page)
+        return page[i & (PAGE_SIZE - 1)];
+      else
+        return zero();
+    }
+  V& get(size_t i)
+    { V* page = pages[i >> PAGE_BITS].load(memory_order_acquire);
+      if (not page)
+        page = allocate(i >> PAGE_BITS);
+      dirty[i >> PAGE_BITS].store(true, memory_order_relaxed);
+      return page[i & (PAGE_SIZE - 1)];
+    }
+
+  // Copy size entries from start with stride, no bounds check
+  void read(V* dest, size_t start, size_t size, long stride = 1) const;
+  void write(const V* source, size_t start, size_t size, long stride = 1);
+
+  // Bytes taken by all pages in a file
+  size_t file_length() const { return n_pages * PAGE_SIZE * sizeof(V); }
+  // Use pages from file copy-on-write
+  void map(int fd, off_t offset, size_t size);
+  // Whether the page layout still matches the file mapped
+  bool is_intact() const { return intact; }
+  // Write pages at offset, untouched pages are left as holes
+  void save(int fd, off_t offset, bool only_dirty);
+};
+
 template<class T> 
 class Memory
 {
-  vector<Share<T> > MS;
-  vector<T> MC;
+  MemoryPages<Share<T> > MS;
+  MemoryPages<T> MC;
 #ifdef MEMPROTECT
   set< pair<unsigned int,unsigned int> > protected_s;
   set< pair<unsigned int,unsigned int> > protected_c;
@@ -44,7 +116,7 @@ class Memory
     { return MS[i]; }
 
   void write_C(unsigned int i,const T& x,int PC=-1)
-    { MC[i]=x;
+    { MC.get(i)=x;
       (void)PC;
 #ifdef MEMPROTECT
     if (is_protected_c(i))
@@ -52,7 +124,7 @@ class Memory
 #endif
     }
   void write_S(unsigned int i,const Share<T> & x,int PC=-1)
-    { MS[i]=x;
+    { MS.get(i)=x;
     (void)PC;
 #ifdef MEMPROTECT
     if (is_protected_s(i))
@@ -61,6 +133,12 @@ class Memory
     }
 
 
+  // Vectorized access to start, start + stride, ... with one bounds check
+  void read_C_range(long start, T* dest, int size, long stride = 1) const;
+  void read_S_range(long start, Share<T>* dest, int size, long stride = 1) const;
+  void write_C_range(long start, const T* source, int size, long stride = 1, int PC=-1);
+  void write_S_range(long start, const Share<T>* source, int size, long stride = 1, int PC=-1);
+
 #ifdef MEMPROTECT
   void protect_s(unsigned int start, unsigned int end);
   void protect_c(unsigned int start, unsigned int end);
@@ -77,6 +155,7 @@ class Memory
 
   friend ostream& operator<< <>(ostream& s,const Memory<T>& M);
   friend istream& operator>> <>(istream& s,Memory<T>& M);
+  friend class MemorySnapshot;
 
 };
 
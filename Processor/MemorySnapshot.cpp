@@ -0,0 +1,149 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * MemorySnapshot.cpp
+ *
+ */
+
+#include "Processor/MemorySnapshot.h"
+#include "Exceptions/Exceptions.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <algorithm>
+
+template<class V>
+void MemorySnapshot::map(MemoryPages<V>& pages, int fd, const Section& section,
+    string type, uint64_t file_size)
+{
+  if (strncmp(type.c_str(), section.type, sizeof(section.type)) != 0
+      or section.element_size != sizeof(V))
+    throw file_error(filename + " has " + string(section.type, strnlen(section.type, sizeof(section.type)))
+        + " instead of " + type);
+  // check against the file before mapping, pages past the end would fault
+  size_t page_length = MemoryPages<V>::PAGE_SIZE * sizeof(V);
+  if (section.size > file_size / sizeof(V)
+      or section.length != (section.size + MemoryPages<V>::PAGE_SIZE - 1)
+          / MemoryPages<V>::PAGE_SIZE * page_length
+      or section.offset > file_size
+      or section.length > file_size - section.offset)
+    throw file_error(filename + " has inconsistent section for " + type);
+  pages.map(fd, section.offset, section.size);
+}
+
+void MemorySnapshot::load(Memory<gf2n>& M2, Memory<gfp>& Mp, Memory<Integer>& Mi)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    {
+      if (errno != ENOENT)
+        throw file_error(filename + ": " + strerror(errno));
+      cerr << "No memory snapshot in " << filename << ", starting empty" << endl;
+      return;
+    }
+
+  Header header;
+  if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+      or header.magic != MEMORY_SNAPSHOT_MAGIC
+      or header.version != MEMORY_SNAPSHOT_VERSION
+      or header.page_size != MemoryPages<gfp>::PAGE_SIZE
+      or header.n_sections != 6)
+    {
+      close(fd);
+      throw file_error(filename + " is not a compatible memory snapshot");
+    }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    {
+      close(fd);
+      throw file_error(filename + ": " + strerror(errno));
+    }
+
+  try
+    {
+      Section* sections = header.sections;
+      uint64_t size = st.st_size;
+      map(M2.MS, fd, sections[0], gf2n::type_string() + " secret", size);
+      map(M2.MC, fd, sections[1], gf2n::type_string() + " clear", size);
+      map(Mp.MS, fd, sections[2], gfp::type_string() + " secret", size);
+      map(Mp.MC, fd, sections[3], gfp::type_string() + " clear", size);
+      map(Mi.MS, fd, sections[4], Integer::type_string() + " secret", size);
+      map(Mi.MC, fd, sections[5], Integer::type_string() + " clear", size);
+    }
+  catch (...)
+    {
+      close(fd);
+      throw;
+    }
+
+  // mappings stay valid after closing
+  close(fd);
+  loaded = true;
+  cerr << "Mapped memory snapshot " << filename << endl;
+}
+
+template<class V>
+void MemorySnapshot::add(Header& header, int i, MemoryPages<V>& pages, string type, off_t& offset)
+{
+  Section& section = header.sections[i];
+  memset(section.type, 0, sizeof(section.type));
+  memcpy(section.type, type.c_str(), min(type.size(), sizeof(section.type)));
+  section.element_size = sizeof(V);
+  section.size = pages.size();
+  section.offset = offset;
+  section.length = pages.file_length();
+  offset += (section.length + 4095) / 4096 * 4096;
+}
+
+void MemorySnapshot::save(Memory<gf2n>& M2, Memory<gfp>& Mp, Memory<Integer>& Mi)
+{
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MEMORY_SNAPSHOT_MAGIC;
+  header.version = MEMORY_SNAPSHOT_VERSION;
+  header.page_size = MemoryPages<gfp>::PAGE_SIZE;
+  header.n_sections = 6;
+  off_t offset = 4096;
+  add(header, 0, M2.MS, gf2n::type_string() + " secret", offset);
+  add(header, 1, M2.MC, gf2n::type_string() + " clear", offset);
+  add(header, 2, Mp.MS, gfp::type_string() + " secret", offset);
+  add(header, 3, Mp.MC, gfp::type_string() + " clear", offset);
+  add(header, 4, Mi.MS, Integer::type_string() + " secret", offset);
+  add(header, 5, Mi.MC, Integer::type_string() + " clear", offset);
+
+  bool incremental = loaded and M2.MS.is_intact() and M2.MC.is_intact()
+      and Mp.MS.is_intact() and Mp.MC.is_intact() and Mi.MS.is_intact()
+      and Mi.MC.is_intact();
+
+  // a new file does not disturb the current mapping
+  string name = incremental ? filename : filename + ".tmp";
+  int fd = open(name.c_str(), O_WRONLY | O_CREAT | (incremental ? 0 : O_TRUNC), 0600);
+  if (fd < 0)
+    throw file_error(name + ": " + strerror(errno));
+  if ((not incremental and ftruncate(fd, offset) != 0)
+      or pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+    {
+      close(fd);
+      throw file_error(name + ": " + strerror(errno));
+    }
+
+  Section* sections = header.sections;
+  M2.MS.save(fd, sections[0].offset, incremental);
+  M2.MC.save(fd, sections[1].offset, incremental);
+  Mp.MS.save(fd, sections[2].offset, incremental);
+  Mp.MC.save(fd, sections[3].offset, incremental);
+  Mi.MS.save(fd, sections[4].offset, incremental);
+  Mi.MC.save(fd, sections[5].offset, incremental);
+
+  if (close(fd) != 0
+      or (not incremental and rename(name.c_str(), filename.c_str()) != 0))
+    throw file_error(name + ": " + strerror(errno));
+
+  cerr << (incremental ? "Updated" : "Wrote") << " memory snapshot " << filename
+      << endl;
+}
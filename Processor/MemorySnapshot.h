@@ -0,0 +1,69 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * MemorySnapshot.h
+ *
+ */
+
+#ifndef PROCESSOR_MEMORYSNAPSHOT_H_
+#define PROCESSOR_MEMORYSNAPSHOT_H_
+
+#include "Processor/Memory.h"
+#include "Math/gf2n.h"
+#include "Math/gfp.h"
+#include "Math/Integer.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+#define MEMORY_SNAPSHOT_MAGIC 0x4d445053
+#define MEMORY_SNAPSHOT_VERSION 1
+
+/*
+ * Binary image of the global memory, mapped copy-on-write on loading.
+ * After the header, there is one section per secret and clear memory
+ * of gf2n, gfp and integer, each starting at a multiple of 4096 bytes
+ * and holding whole pages of raw values. Pages never written are holes.
+ * The values depend on the field setup like Memory-P<i>.
+ */
+class MemorySnapshot
+{
+  struct Section
+  {
+    char type[16];
+    uint64_t element_size;
+    uint64_t size;
+    uint64_t offset;
+    uint64_t length;
+  };
+
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t n_sections;
+    Section sections[6];
+  };
+
+  string filename;
+  bool loaded;
+
+  template<class V>
+  void map(MemoryPages<V>& pages, int fd, const Section& section, string type,
+      uint64_t file_size);
+  template<class V>
+  void add(Header& header, int i, MemoryPages<V>& pages, string type, off_t& offset);
+
+public:
+  MemorySnapshot(string filename) : filename(filename), loaded(false) {}
+
+  // Keeps the memory empty if the file does not exist
+  void load(Memory<gf2n>& M2, Memory<gfp>& Mp, Memory<Integer>& Mi);
+  // Only writes pages changed since loading if the layout is unchanged
+  void save(Memory<gf2n>& M2, Memory<gfp>& Mp, Memory<Integer>& Mi);
+};
+
+#endif /* PROCESSOR_MEMORYSNAPSHOT_H_ */
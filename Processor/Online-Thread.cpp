@@ -7,6 +7,10 @@
 #include "Processor/Data_Files.h"
 #include "Processor/Machine.h"
 #include "Processor/Processor.h"
+#include "Networking/EpollPlayer.h"
+#include "Networking/ShmPlayer.h"
+#include "Networking/ChannelPlayer.h"
+#include "Networking/EmulatedPlayer.h"
 
 #include <iostream>
 #include <fstream>
@@ -18,15 +22,37 @@ void* Sub_Main_Func(void* ptr)
 {
   thread_info *tinfo=(thread_info *) ptr;
   Machine& machine=*(tinfo->machine);
-  vector<pthread_mutex_t>& t_mutex      = machine.t_mutex;
-  vector<pthread_cond_t>& client_ready  = machine.client_ready;
-  vector<pthread_cond_t>& server_ready  = machine.server_ready;
   vector<Program>& progs                = machine.progs;
 
   int num=tinfo->thread_num;
   fprintf(stderr, "\tI am in thread %d\n",num);
+  // before allocating anything so that it is local to the CPU
+  machine.affinity.pin(num);
   Player* player;
-  if (!machine.receive_threads or machine.direct or machine.parallel)
+  if (not NetworkEmulation::filename.empty())
+    {
+      cerr << "Emulating network described in " << NetworkEmulation::filename << endl;
+      if (ShmPlayer::enabled)
+        player = new EmulatedPlayer<ShmPlayer>(*(tinfo->Nms), num << 16);
+      else
+        player = new EmulatedPlayer<Player>(*(tinfo->Nms), num << 16);
+    }
+  else if (ShmPlayer::enabled)
+    {
+      cerr << "Using shared memory for communication" << endl;
+      player = new ShmPlayer(*(tinfo->Nms), num << 16);
+    }
+  else if (ChannelPlayer::enabled)
+    {
+      cerr << "Using channels on shared connections for communication" << endl;
+      player = new ChannelPlayer(*(tinfo->Nms), num << 16);
+    }
+  else if (EpollPlayer::enabled)
+    {
+      cerr << "Using event loop for communication" << endl;
+      player = new EpollPlayer(*(tinfo->Nms), num << 16);
+    }
+  else if (!machine.receive_threads or machine.direct or machine.parallel)
     {
       cerr << "Using single-threaded receiving" << endl;
       player = new Player(*(tinfo->Nms), num << 16);
@@ -40,6 +66,9 @@ void* Sub_Main_Func(void* ptr)
   fprintf(stderr, "\tSet up player in thread %d\n",num);
 
   Data_Files DataF(P.my_num(),P.num_players(),machine.prep_dir_prefix);
+  // a pipe only has one reader
+  if (num == 0)
+    DataF.attach_pipes();
 
   MAC_Check<gf2n>* MC2;
   MAC_Check<gfp>*  MCp;
@@ -68,45 +97,47 @@ void* Sub_Main_Func(void* ptr)
   Processor Proc(tinfo->thread_num,DataF,P,*MC2,*MCp,machine,progs[0]);
   Share<gf2n> a,b,c;
 
-  bool flag=true;
-  int program=-3; 
+  bool failed=false;
+  exception_ptr failure;
+  int query=machine.query;
+  string input_dir=machine.input_dir;
+  tape_job job;
   // int exec=0;
 
   // synchronize
-  cerr << "Locking for sync of thread " << num << endl;
-  pthread_mutex_lock(&t_mutex[num]);
-  tinfo->ready=true;
-  pthread_cond_signal(&client_ready[num]);
-  pthread_mutex_unlock(&t_mutex[num]);
+  tinfo->ready.set_value();
 
   Timer thread_timer(CLOCK_THREAD_CPUTIME_ID), wait_timer;
   thread_timer.start();
 
-  while (flag)
+  while (true)
     { // Wait until I have a program to run
       wait_timer.start();
-      pthread_mutex_lock(&t_mutex[num]);
-        if ((tinfo->prognum)==-2)
-	  { pthread_cond_wait(&server_ready[num],&t_mutex[num]); }
-      program=(tinfo->prognum);
-      (tinfo->prognum)=-2;
-      pthread_mutex_unlock(&t_mutex[num]);
+      bool running = tinfo->jobs->pop(job);
       wait_timer.stop();
+      if (not running)
+        break;
+      if (failed)
+        { // fail all jobs until stopped so that nobody waits forever
+          job.done->set_exception(failure);
+          continue;
+        }
+      int program = job.prognum;
       //printf("\tRunning program %d\n",program);
 
-      if (program==-1)
-        { flag=false;
-        //statistics comment out (start)
-//          fprintf(stderr, "\tThread %d terminating\n",num);
-          //statistics comment out (end)
-        }
-      else
+      try
         { // RUN PROGRAM
           //printf("\tClient %d about to run %d in execution %d\n",num,program,exec);
-          Proc.reset(progs[program],tinfo->arg);
+          if (machine.query != query or machine.input_dir != input_dir)
+            { // persistent server running another schedule
+              query = machine.query;
+              input_dir = machine.input_dir;
+              Proc.restart_io();
+            }
+          Proc.reset(progs[program],job.arg);
 
           // Bits, Triples, Squares, and Inverses skipping
-          DataF.seekg(tinfo->pos);
+          DataF.seekg(job.pos);
              
           //printf("\tExecuting program");
           // Execute the program
@@ -129,31 +160,29 @@ void* Sub_Main_Func(void* ptr)
           //printf("\tMAC checked\n");
           P.Check_Broadcast();
           //printf("\tBroadcast checked\n");
+        }
+      catch (...)
+        { // hand over to whoever joins this tape, the thread is unusable
+          failure = current_exception();
+          job.done->set_exception(failure);
+          failed = true;
+          continue;
+        }
 
-         // printf("\tSignalling I have finished\n");
-          wait_timer.start();
-         pthread_mutex_lock(&t_mutex[num]);
-            (tinfo->finished)=true;
-            pthread_cond_signal(&client_ready[num]);
-	 pthread_mutex_unlock(&t_mutex[num]);
-	 wait_timer.stop();
-       }  
+      // printf("\tSignalling I have finished\n");
+      job.done->set_value();
     }
 
-  // MACCheck
-  MC2->Check(P);
-  MCp->Check(P);
-  
-  //cout << num << " : Checking broadcast" << endl;
-  P.Check_Broadcast();
-  //cout << num << " : Broadcast checked "<< endl;
-
-  wait_timer.start();
-  pthread_mutex_lock(&t_mutex[num]);
-  if (!tinfo->ready)
-    pthread_cond_wait(&server_ready[num], &t_mutex[num]);
-  pthread_mutex_unlock(&t_mutex[num]);
-  wait_timer.stop();
+  if (not failed)
+    {
+      // MACCheck
+      MC2->Check(P);
+      MCp->Check(P);
+
+      //cout << num << " : Checking broadcast" << endl;
+      P.Check_Broadcast();
+      //cout << num << " : Broadcast checked "<< endl;
+    }
 
   // statistics comment out (start)
 //  cerr << num << " : MAC Checking" << endl;
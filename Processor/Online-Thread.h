@@ -8,12 +8,29 @@
 #include "Math/gfp.h"
 #include "Math/Integer.h"
 #include "Processor/Data_Files.h"
+#include "Tools/WaitQueue.h"
 
 #include <vector>
+#include <memory>
+#include <future>
 using namespace std;
 
 class Machine;
 
+// Tape to be run by an online thread
+class tape_job
+{
+  public:
+
+  int prognum;
+  // Integer arg (optional)
+  int arg;
+  // rownums for triples, bits, squares, and inverses etc
+  DataPositions pos;
+  // fulfilled once the tape and the MAC check have finished
+  shared_ptr< promise<void> > done;
+};
+
 class thread_info
 {
   public: 
@@ -23,14 +40,16 @@ class thread_info
   Names*  Nms;
   gf2n *alpha2i;
   gfp  *alphapi;
-  int prognum;
-  bool finished;
-  bool ready;
 
-  // rownums for triples, bits, squares, and inverses etc
+  // Jobs in order of submission, stopped when shutting down
+  WaitQueue<tape_job>* jobs;
+  // Completion of the last job submitted
+  future<void> finished;
+  // Set once the thread has set up its player and processor
+  promise<void> ready;
+
+  // File positions after a tape with unknown usage
   DataPositions pos;
-  // Integer arg (optional)
-  int arg;
 
   Machine* machine;
 };
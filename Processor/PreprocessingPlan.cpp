@@ -0,0 +1,153 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * PreprocessingPlan.cpp
+ *
+ */
+
+#include "Processor/PreprocessingPlan.h"
+#include "Processor/Program.h"
+#include "Exceptions/Exceptions.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <iomanip>
+
+bool PreprocessingPlan::enabled = false;
+
+void PreprocessingPlan::add_schedule(const string& progname,
+        const vector<Program>& progs)
+{
+    this->progname = progname;
+    string filename = "Programs/Schedules/" + progname + ".sch";
+    ifstream inpf(filename.c_str());
+    if (inpf.fail())
+        throw file_error(filename);
+
+    // same format as in Machine
+    int nthreads, nprogs;
+    inpf >> nthreads >> nprogs;
+    string threadname;
+    for (int i = 0; i < nprogs; i++)
+        inpf >> threadname;
+
+    int numt;
+    while (inpf >> numt and numt != 0)
+        for (int i = 0; i < numt; i++)
+        {
+            int tn, arg;
+            inpf >> tn;
+            if (inpf.get() == ':')
+                inpf >> arg;
+            if (tn < 0 or tn >= (int)progs.size())
+                throw Processor_Error(filename + ": invalid tape number "
+                        + to_string(tn));
+            if (progs[tn].usage_unknown())
+                n_unknown++;
+            total.increase(progs[tn].get_offline_data_used());
+        }
+    if (inpf.fail())
+        throw file_error("cannot parse " + filename);
+}
+
+void PreprocessingPlan::print(ostream& os) const
+{
+    os << "Preprocessing needed by " << progname;
+    if (n_unknown)
+        os << " (at least, " << n_unknown
+                << " tape runs have unknown usage)";
+    os << ":" << endl;
+    for (int i = 0; i < N_DATA_FIELD_TYPE; i++)
+    {
+        for (int j = 0; j < N_DTYPE; j++)
+            if (total.files[i][j])
+                os << "  " << setw(12) << total.files[i][j] << " "
+                        << Data_Files::long_field_names[i] << " "
+                        << Data_Files::dtype_names[j] << endl;
+        for (unsigned j = 0; j < total.inputs.size(); j++)
+            if (total.inputs[j][i])
+                os << "  " << setw(12) << total.inputs[j][i] << " "
+                        << Data_Files::long_field_names[i]
+                        << " inputs from player " << j << endl;
+        for (auto& x : total.extended[i])
+            os << "  " << setw(12) << x.second << " "
+                    << Data_Files::long_field_names[i] << " "
+                    << x.first.get_string() << endl;
+    }
+}
+
+void PreprocessingPlan::write(const string& filename) const
+{
+    ofstream outf(filename.c_str());
+    outf << "# " << progname << (n_unknown ? " lower bound" : " exact") << endl;
+    for (int i = 0; i < N_DATA_FIELD_TYPE; i++)
+    {
+        const char* field = Data_Files::long_field_names[i];
+        for (int j = 0; j < N_DTYPE; j++)
+            if (Data_Files::implemented[i][j])
+                outf << field << " " << Data_Files::dtype_names[j] << " "
+                        << total.files[i][j] << endl;
+        for (unsigned j = 0; j < total.inputs.size(); j++)
+            outf << field << " Inputs-" << j << " " << total.inputs[j][i]
+                    << endl;
+        for (auto& x : total.extended[i])
+            outf << field << " " << x.first.get_string() << " " << x.second
+                    << endl;
+    }
+    if (outf.fail())
+        throw file_error(filename);
+}
+
+// returns false if the file is too short
+static bool prepare_file(string filename, long long start,
+        long long count, int tuple_length, int field_type)
+{
+    if (count == 0)
+        return true;
+    Data_Files::use_packed(filename, tuple_length, field_type);
+    off_t begin = start * tuple_length;
+    off_t length = count * tuple_length;
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 or fstat(fd, &st) < 0)
+        st.st_size = 0;
+    if (st.st_size < begin + length)
+    {
+        cerr << filename << " has " << max(0ll, st.st_size / tuple_length - start)
+                << " tuples left but " << count << " are needed" << endl;
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    posix_fadvise(fd, begin, length, POSIX_FADV_WILLNEED);
+    close(fd);
+    return true;
+}
+
+int PreprocessingPlan::prepare_files(const string& prep_dir, int my_num,
+        const DataPositions& start, bool fail) const
+{
+    int n_short = 0;
+    for (int i = 0; i < N_DATA_FIELD_TYPE; i++)
+    {
+        for (int j = 0; j < N_DTYPE; j++)
+            if (Data_Files::implemented[i][j])
+                n_short += not prepare_file(
+                        Data_Files::get_filename(prep_dir, i, j, my_num),
+                        start.files[i][j], total.files[i][j],
+                        Data_Files::tuple_length(i, j), i);
+        for (unsigned j = 0; j < total.inputs.size(); j++)
+        {
+            int tuple_length = Data_Files::share_length(i);
+            if ((int)j == my_num)
+                tuple_length = tuple_length * 3 / 2;
+            n_short += not prepare_file(
+                    Data_Files::get_input_filename(prep_dir, i, my_num, j),
+                    start.inputs[j][i], total.inputs[j][i], tuple_length, i);
+        }
+    }
+    if (n_short and fail)
+        throw not_enough_to_buffer(" for " + progname);
+    return n_short;
+}
@@ -0,0 +1,58 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * PreprocessingPlan.h
+ *
+ */
+
+#ifndef PROCESSOR_PREPROCESSINGPLAN_H_
+#define PROCESSOR_PREPROCESSINGPLAN_H_
+
+#include "Processor/Data_Files.h"
+
+#include <vector>
+#include <string>
+using namespace std;
+
+class Program;
+
+/*
+ * Preprocessed data needed by a whole schedule, summing the usage
+ * of every tape run in it. Tapes with unknown usage (loops with
+ * run-time bounds) are only counted as known, so the result is a
+ * lower bound if there are any.
+ *
+ * The plan is written as text, one item per line:
+ *   <field> <type> <count>
+ * where type is a data type, an extended tag, or Inputs-<player>.
+ * Offline generators accept it with --plan.
+ */
+class PreprocessingPlan
+{
+    string progname;
+    int n_unknown;
+
+public:
+    // Compute, check and pre-fetch for every schedule loaded (-pl)
+    static bool enabled;
+
+    DataPositions total;
+
+    PreprocessingPlan(int num_players) : n_unknown(0), total(num_players) {}
+
+    // Sum over the execution lines of Programs/Schedules/<progname>.sch
+    void add_schedule(const string& progname, const vector<Program>& progs);
+
+    bool exact() const { return n_unknown == 0; }
+
+    void print(ostream& os) const;
+    void write(const string& filename) const;
+
+    // Check that the files for a party contain the planned data
+    // after the given positions and have the kernel read it ahead.
+    // Returns the number of files that are too short.
+    int prepare_files(const string& prep_dir, int my_num,
+            const DataPositions& start, bool fail = true) const;
+};
+
+#endif /* PROCESSOR_PREPROCESSINGPLAN_H_ */
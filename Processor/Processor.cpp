@@ -18,17 +18,13 @@ Processor::Processor(int thread_num,Data_Files& DataF,Player& P,
         MAC_Check<gf2n>& MC2,MAC_Check<gfp>& MCp,Machine& machine,
         const Program& program)
 : thread_num(thread_num),DataF(DataF),P(P),MC2(MC2),MCp(MCp),machine(machine),
-  private_input_filename(get_filename(PREP_DIR "Private-Input-",true)),
   input2(*this,MC2),inputp(*this,MCp),privateOutput2(*this),privateOutputp(*this),sent(0),rounds(0),
   external_clients(ExternalClients(P.my_num(), DataF.prep_data_dir)),binary_file_io(Binary_File_IO()),
   mult_allocated(0), bmult_allocated(0), open_allocated(0), bopen_allocated(0), input_file_int(NULL), input_file_fix(NULL), input_file_share(NULL)
 {
   reset(program,0);
 
-  public_input.open(get_filename("Programs/Public-Input/",false).c_str());
-  private_input.open(private_input_filename.c_str());
-  public_output.open(get_filename(PREP_DIR "Public-Output-",true).c_str(), ios_base::out);
-  private_output.open(get_filename(PREP_DIR "Private-Output-",true).c_str(), ios_base::out);
+  open_io_files();
 
   spdz_gfp_ext_context.handle = 0;
   cout << "Processor " << thread_num << " SPDZ GFP extension library initializing." << endl;
@@ -81,6 +77,34 @@ Processor::~Processor()
   dlclose(the_ext_lib_z2.ext_lib_handle);
 }
 
+void Processor::open_io_files()
+{
+  for (auto file : { &public_input, &private_input })
+    if (file->is_open())
+      file->close();
+  for (auto file : { &public_output, &private_output })
+    if (file->is_open())
+      file->close();
+  public_input.clear();
+  private_input.clear();
+  if (machine.input_dir.empty())
+    private_input_filename = get_filename(PREP_DIR "Private-Input-",true);
+  else
+    private_input_filename = get_filename((machine.input_dir + "/Private-Input-").c_str(),true);
+  public_input.open(get_filename("Programs/Public-Input/",false).c_str());
+  private_input.open(private_input_filename.c_str());
+  public_output.open(get_filename(PREP_DIR "Public-Output-",true).c_str(), ios_base::out);
+  private_output.open(get_filename(PREP_DIR "Private-Output-",true).c_str(), ios_base::out);
+}
+
+void Processor::restart_io()
+{
+  open_io_files();
+  close_input_file();
+  if(0 != open_input_file())
+    throw file_error("SPDZ extension library input files");
+}
+
 string Processor::get_filename(const char* prefix, bool use_number)
 {
   stringstream filename;
@@ -314,8 +338,12 @@ void Processor::init_secure_socket_internal(int client_id, const vector<int>& re
   // Use results of STS to generate send and receive keys.
   vector<unsigned char> sendKey = ke.derive_secret(crypto_secretbox_KEYBYTES);
   vector<unsigned char> recvKey = ke.derive_secret(crypto_secretbox_KEYBYTES);
-  external_clients.symmetric_client_commsec_send_keys[client_id] = make_pair(sendKey,0);
-  external_clients.symmetric_client_commsec_recv_keys[client_id] = make_pair(recvKey,0);
+  external_clients.symmetric_client_commsec_send_keys[client_id] = make_pair(
+      shared_ptr<SequenceCipher>(SequenceCipher::create(sendKey)),0);
+  external_clients.symmetric_client_commsec_recv_keys[client_id] = make_pair(
+      shared_ptr<SequenceCipher>(SequenceCipher::create(recvKey)),0);
+  sodium_memzero(sendKey.data(), sendKey.size());
+  sodium_memzero(recvKey.data(), recvKey.size());
 }
 
 void Processor::init_secure_socket(int client_id, const vector<int>& registers) {
@@ -383,8 +411,12 @@ void Processor::resp_secure_socket_internal(int client_id, const vector<int>& re
   // Use results of STS to generate send and receive keys.
   vector<unsigned char> recvKey = ke.derive_secret(crypto_secretbox_KEYBYTES);
   vector<unsigned char> sendKey = ke.derive_secret(crypto_secretbox_KEYBYTES);
-  external_clients.symmetric_client_commsec_recv_keys[client_id] = make_pair(recvKey,0);
-  external_clients.symmetric_client_commsec_send_keys[client_id] = make_pair(sendKey,0);
+  external_clients.symmetric_client_commsec_recv_keys[client_id] = make_pair(
+      shared_ptr<SequenceCipher>(SequenceCipher::create(recvKey)),0);
+  external_clients.symmetric_client_commsec_send_keys[client_id] = make_pair(
+      shared_ptr<SequenceCipher>(SequenceCipher::create(sendKey)),0);
+  sodium_memzero(sendKey.data(), sendKey.size());
+  sodium_memzero(recvKey.data(), recvKey.size());
 }
 
 // Read share data from a file starting at file_pos until registers filled.
@@ -591,24 +623,77 @@ ostream& operator<<(ostream& s,const Processor& P)
 
 void Processor::maybe_decrypt_sequence(int client_id)
 {
-  map<int, pair<vector<octet>,uint64_t> >::iterator it_cs = external_clients.symmetric_client_commsec_recv_keys.find(client_id);
+  auto it_cs = external_clients.symmetric_client_commsec_recv_keys.find(client_id);
   if (it_cs != external_clients.symmetric_client_commsec_recv_keys.end())
   {
-    socket_stream.decrypt_sequence(&it_cs->second.first[0], it_cs->second.second);
+    it_cs->second.first->decrypt(socket_stream, it_cs->second.second);
     it_cs->second.second++;
   }
 }
 
 void Processor::maybe_encrypt_sequence(int client_id)
 {
-  map<int, pair<vector<octet>,uint64_t> >::iterator it_cs = external_clients.symmetric_client_commsec_send_keys.find(client_id);
+  auto it_cs = external_clients.symmetric_client_commsec_send_keys.find(client_id);
   if (it_cs != external_clients.symmetric_client_commsec_send_keys.end())
   {
-    socket_stream.encrypt_sequence(&it_cs->second.first[0], it_cs->second.second);
+    it_cs->second.first->encrypt(socket_stream, it_cs->second.second);
     it_cs->second.second++;
   }
 }
 
+template <class T>
+static T* register_range(vector<T>& registers, int start, int size)
+{
+  if (start < 0 or start + size > (int)registers.size())
+    throw Processor_Error("register range out of bounds: " + to_string(start)
+        + "+" + to_string(size) + "/" + to_string(registers.size()));
+  return registers.data() + start;
+}
+
+template <class T>
+void Processor::load_C(int reg, const Memory<T>& M, long start, int size, long stride)
+{
+  M.read_C_range(start, register_range(get_C<T>(), reg, size), size, stride);
+}
+
+template <class T>
+void Processor::load_S(int reg, const Memory<T>& M, long start, int size, long stride)
+{
+  M.read_S_range(start, register_range(get_S<T>(), reg, size), size, stride);
+}
+
+template <class T>
+void Processor::store_C(int reg, Memory<T>& M, long start, int size, long stride)
+{
+  M.write_C_range(start, register_range(get_C<T>(), reg, size), size, stride, PC);
+}
+
+template <class T>
+void Processor::store_S(int reg, Memory<T>& M, long start, int size, long stride)
+{
+  M.write_S_range(start, register_range(get_S<T>(), reg, size), size, stride, PC);
+}
+
+bool Processor::get_stride(int reg, int size, long& start, long& stride)
+{
+  long* addresses = register_range(Ci, reg, size);
+  start = addresses[0];
+  stride = size > 1 ? addresses[1] - addresses[0] : 1;
+  for (int i = 2; i < size; i++)
+    if (addresses[i] - addresses[i - 1] != stride)
+      return false;
+  return true;
+}
+
+template void Processor::load_C(int reg, const Memory<gf2n>& M, long start, int size, long stride);
+template void Processor::load_C(int reg, const Memory<gfp>& M, long start, int size, long stride);
+template void Processor::load_S(int reg, const Memory<gf2n>& M, long start, int size, long stride);
+template void Processor::load_S(int reg, const Memory<gfp>& M, long start, int size, long stride);
+template void Processor::store_C(int reg, Memory<gf2n>& M, long start, int size, long stride);
+template void Processor::store_C(int reg, Memory<gfp>& M, long start, int size, long stride);
+template void Processor::store_S(int reg, Memory<gf2n>& M, long start, int size, long stride);
+template void Processor::store_S(int reg, Memory<gfp>& M, long start, int size, long stride);
+
 template void Processor::POpen_Start(const vector<int>& reg,const Player& P,MAC_Check<gf2n>& MC,int size);
 template void Processor::POpen_Start(const vector<int>& reg,const Player& P,MAC_Check<gfp>& MC,int size);
 template void Processor::POpen_Stop(const vector<int>& reg,const Player& P,MAC_Check<gf2n>& MC,int size);
@@ -1694,13 +1779,14 @@ void Processor::import_clears(const clear_t & clear_in, vector< gf2n > & clears_
 int Processor::open_input_file()
 {
 	char buffer[256];
+	string input_prefix = machine.input_dir.empty() ? "" : machine.input_dir + "/";
 
-	snprintf(buffer, 256, "integers_input_%d.txt", P.my_num());
+	snprintf(buffer, 256, "%sintegers_input_%d.txt", input_prefix.c_str(), P.my_num());
 	input_file_int = fopen(buffer, "r");
 	if(NULL == input_file_int)
 		return -1;
 
-	snprintf(buffer, 256, "fixes_input_%d.txt", P.my_num());
+	snprintf(buffer, 256, "%sfixes_input_%d.txt", input_prefix.c_str(), P.my_num());
 	input_file_fix = fopen(buffer, "r");
 	if(NULL == input_file_fix)
 	{
@@ -1708,7 +1794,7 @@ int Processor::open_input_file()
 		return -1;
 	}
 
-	snprintf(buffer, 256, "bits_input_%d.txt", P.my_num());
+	snprintf(buffer, 256, "%sbits_input_%d.txt", input_prefix.c_str(), P.my_num());
 	input_file_bit = fopen(buffer, "r");
 	if(NULL == input_file_bit)
 	{
@@ -1717,7 +1803,7 @@ int Processor::open_input_file()
 		return -1;
 	}
 
-	snprintf(buffer, 256, "shares_input_%d.txt", P.my_num());
+	snprintf(buffer, 256, "%sshares_input_%d.txt", input_prefix.c_str(), P.my_num());
 	input_file_share = fopen(buffer, "r");
 	if(NULL == input_file_share)
 	{
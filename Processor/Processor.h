@@ -181,6 +181,7 @@ class Processor : public ProcessorBase
   static const int reg_bytes = 4;
   
   void reset(const Program& program,int arg); // Reset the state of the processor
+  void restart_io(); // Read inputs from the start when running another schedule
   string get_filename(const char* basename, bool use_number);
 
   Processor(int thread_num,Data_Files& DataF,Player& P,
@@ -300,6 +301,18 @@ class Processor : public ProcessorBase
   template<class T> Share<T>& get_S_ref(int i);
   template<class T> T& get_C_ref(int i);
 
+  // Vectorized memory instructions with one bounds check
+  template <class T>
+  void load_C(int reg, const Memory<T>& M, long start, int size, long stride = 1);
+  template <class T>
+  void load_S(int reg, const Memory<T>& M, long start, int size, long stride = 1);
+  template <class T>
+  void store_C(int reg, Memory<T>& M, long start, int size, long stride = 1);
+  template <class T>
+  void store_S(int reg, Memory<T>& M, long start, int size, long stride = 1);
+  // Whether the addresses in integer registers are evenly spaced
+  bool get_stride(int reg, int size, long& start, long& stride);
+
   // Access to external client sockets for reading clear/shared data
   void read_socket_ints(int client_id, const vector<int>& registers);
   // Setup client public key
@@ -396,6 +409,7 @@ class Processor : public ProcessorBase
   friend ostream& operator<<(ostream& s,const Processor& P);
 
   private:
+    void open_io_files();
     void maybe_decrypt_sequence(int client_id);
     void maybe_encrypt_sequence(int client_id);
 
@@ -4,6 +4,22 @@
 #include "Processor/Program.h"
 #include "Processor/Data_Files.h"
 #include "Processor/Processor.h"
+#include "Exceptions/Exceptions.h"
+#include "Tools/mkpath.h"
+
+#include <sodium.h>
+#include <sstream>
+#include <iomanip>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char* Program::cache_dir = "Programs/Decoded/";
+
+// Magic number and format version of the decoded-tape cache
+#define TAPE_CACHE_MAGIC 0x54445053
+#define TAPE_CACHE_VERSION 1
 
 void Program::compute_constants()
 {
@@ -42,6 +58,173 @@ void Program::parse(istream& s)
   compute_constants();
 }
 
+void Program::parse(const string& filename)
+{
+  ifstream pinp(filename.c_str());
+  if (pinp.fail()) { throw file_error(filename); }
+  stringstream bytecode;
+  bytecode << pinp.rdbuf();
+  pinp.close();
+
+  string cache_name = get_cache_name(bytecode.str());
+  if (load_cache(cache_name))
+    {
+      cerr << "Using decoded tape " << cache_name << endl;
+      return;
+    }
+
+  parse(bytecode);
+  write_cache(cache_name);
+}
+
+string Program::get_cache_name(const string& bytecode) const
+{
+  // the number of players determines the size of the input usage
+  int header[] = { TAPE_CACHE_VERSION, (int)offline_data_used.inputs.size() };
+  octet hash[crypto_generichash_BYTES_MIN];
+  crypto_generichash_state state;
+  crypto_generichash_init(&state, NULL, 0, sizeof(hash));
+  crypto_generichash_update(&state, (octet*)header, sizeof(header));
+  crypto_generichash_update(&state, (octet*)bytecode.data(), bytecode.size());
+  crypto_generichash_final(&state, hash, sizeof(hash));
+
+  stringstream ss;
+  ss << cache_dir << hex << setfill('0');
+  for (size_t i = 0; i < sizeof(hash); i++)
+    ss << setw(2) << (int)hash[i];
+  return ss.str();
+}
+
+/* The cache file is a flat array of integers:
+ *   magic version length nplayers unknown_usage
+ *   max_reg[] max_mem[][] files[][] inputs[][]
+ *   per field type: number of tags, (tag[3] count)*
+ *   number of instructions, flattened instructions
+ * All counts are checked against the length, and the tape is parsed
+ * instead if they do not fit.
+ */
+bool Program::load_cache(const string& cache_name)
+{
+  int fd = open(cache_name.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0 or st.st_size < 5 * (off_t)sizeof(int))
+    {
+      close(fd);
+      return false;
+    }
+  void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  const int* data = (const int*)map;
+  int nplayers = offline_data_used.inputs.size();
+  bool valid = data[0] == TAPE_CACHE_MAGIC and data[1] == TAPE_CACHE_VERSION
+      and data[2] * (off_t)sizeof(int) == st.st_size and data[3] == nplayers;
+  const int* end = data + (valid ? data[2] : 0);
+  if (valid)
+    {
+      data += 4;
+      long n_fixed = 1 + MAX_REG_TYPE * (1 + MAX_SECRECY_TYPE);
+      for (auto& x : offline_data_used.files)
+        n_fixed += x.size();
+      for (auto& x : offline_data_used.inputs)
+        n_fixed += x.size();
+      valid = n_fixed <= end - data;
+    }
+  if (valid)
+    {
+      unknown_usage = *data++;
+      for (int reg_type = 0; reg_type < MAX_REG_TYPE; reg_type++)
+        max_reg[reg_type] = *data++;
+      for (int reg_type = 0; reg_type < MAX_REG_TYPE; reg_type++)
+        for (int sec_type = 0; sec_type < MAX_SECRECY_TYPE; sec_type++)
+          max_mem[reg_type][sec_type] = *data++;
+      for (auto& x : offline_data_used.files)
+        for (auto& y : x)
+          y = *data++;
+      for (auto& x : offline_data_used.inputs)
+        for (auto& y : x)
+          y = *data++;
+      for (auto& x : offline_data_used.extended)
+        {
+          x.clear();
+          int n_tags = valid and data < end ? *data++ : -1;
+          valid = n_tags >= 0 and n_tags <= (end - data) / 4;
+          for (int i = 0; valid and i < n_tags; i++)
+            {
+              x[DataTag(data)] = data[3];
+              data += 4;
+            }
+        }
+      int n_instructions = valid and data < end ? *data++ : -1;
+      // every instruction takes at least eight integers
+      valid = n_instructions >= 0 and n_instructions <= (end - data) / 8;
+      if (valid)
+        p.resize(n_instructions);
+      for (size_t i = 0; valid and i < p.size(); i++)
+        {
+          data = p[i].unflatten(data, end);
+          valid = data != 0;
+        }
+      valid = valid and data == end;
+    }
+
+  munmap(map, st.st_size);
+  if (not valid)
+    {
+      // leave nothing behind for parse()
+      p.clear();
+      offline_data_used = DataPositions(nplayers);
+      unknown_usage = false;
+    }
+  return valid;
+}
+
+void Program::write_cache(const string& cache_name) const
+{
+  vector<int> res = { TAPE_CACHE_MAGIC, TAPE_CACHE_VERSION, 0,
+      (int)offline_data_used.inputs.size(), unknown_usage };
+  res.insert(res.end(), max_reg, max_reg + MAX_REG_TYPE);
+  for (int reg_type = 0; reg_type < MAX_REG_TYPE; reg_type++)
+    res.insert(res.end(), max_mem[reg_type], max_mem[reg_type] + MAX_SECRECY_TYPE);
+  for (auto& x : offline_data_used.files)
+    res.insert(res.end(), x.begin(), x.end());
+  for (auto& x : offline_data_used.inputs)
+    res.insert(res.end(), x.begin(), x.end());
+  for (auto& x : offline_data_used.extended)
+    {
+      res.push_back(x.size());
+      for (auto& it : x)
+        {
+          int tag[3] = { 0, 0, 0 };
+          string tag_string = it.first.get_string();
+          memcpy(tag, tag_string.c_str(), min(tag_string.size(), sizeof(tag)));
+          res.insert(res.end(), tag, tag + 3);
+          res.push_back(it.second);
+        }
+    }
+  res.push_back(p.size());
+  for (auto& instr : p)
+    instr.flatten(res);
+  res[2] = res.size();
+
+  // write to temporary file first because other parties
+  // on the same host might be reading at the same time
+  mkdir_p(cache_dir);
+  string tmp_name = cache_name + "." + to_string(getpid());
+  ofstream out(tmp_name.c_str(), ios::out | ios::binary);
+  out.write((char*)res.data(), res.size() * sizeof(int));
+  out.close();
+  if (out.fail() or rename(tmp_name.c_str(), cache_name.c_str()) != 0)
+    {
+      cerr << "Could not write decoded tape to " << cache_name << endl;
+      unlink(tmp_name.c_str());
+    }
+}
+
 void Program::print_offline_cost() const
 {
   if (unknown_usage)
@@ -72,8 +255,20 @@ void Program::execute(Processor& Proc) const
   octet seed[SEED_SIZE];
   memset(seed, 0, SEED_SIZE);
   Proc.prng.SetSeed(seed);
-  while (Proc.PC<size)
-    { p[Proc.PC].execute(Proc); }
+  TrafficStats* traffic = Proc.P.traffic;
+  if (traffic)
+    {
+      // attribute communication to tape and instruction
+      traffic->set_tape(name);
+      while (Proc.PC<size)
+        { traffic->instruction = p[Proc.PC].get_opcode();
+          p[Proc.PC].execute(Proc);
+        }
+      traffic->instruction = -1;
+    }
+  else
+    while (Proc.PC<size)
+      { p[Proc.PC].execute(Proc); }
 }
 
 
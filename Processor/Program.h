@@ -30,14 +30,27 @@ class Program
 
   void compute_constants();
 
+  // Decoded-tape cache
+  string get_cache_name(const string& bytecode) const;
+  bool load_cache(const string& cache_name);
+  void write_cache(const string& cache_name) const;
+
   public:
 
+  // Where decoded tapes are cached, keyed by a hash of the bytecode
+  static const char* cache_dir;
+
+  // Tape name from the schedule
+  string name;
+
   Program(int nplayers) : offline_data_used(nplayers),
       unknown_usage(false)
     { compute_constants(); }
 
   // Read in a program
   void parse(istream& s);
+  // Read in a program from a bytecode file, using the cache if possible
+  void parse(const string& filename);
 
   DataPositions get_offline_data_used() const { return offline_data_used; }
   void print_offline_cost() const;
@@ -0,0 +1,142 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * Affinity.cpp
+ *
+ */
+
+#include "Tools/Affinity.h"
+
+#include <pthread.h>
+#include <dirent.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+vector<int> CpuAffinity::parse_cpulist(const string& list)
+{
+    vector<int> res;
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ','))
+    {
+        if (range.empty() or range == "\n")
+            continue;
+        char* end;
+        int first = strtol(range.c_str(), &end, 10);
+        int last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        if (end == range.c_str() or (*end != 0 and *end != '\n')
+                or first < 0 or last < first)
+            throw runtime_error("invalid CPU list: " + list);
+        for (int i = first; i <= last; i++)
+            res.push_back(i);
+    }
+    return res;
+}
+
+vector< vector<int> > CpuAffinity::get_nodes(const cpu_set_t& allowed)
+{
+    vector< pair<int, vector<int> > > found;
+    const char* dirname = "/sys/devices/system/node";
+    DIR* dir = opendir(dirname);
+    if (dir)
+    {
+        struct dirent* entry;
+        while ((entry = readdir(dir)))
+        {
+            int node;
+            if (sscanf(entry->d_name, "node%d", &node) != 1)
+                continue;
+            ifstream cpulist(string(dirname) + "/" + entry->d_name + "/cpulist");
+            string list;
+            getline(cpulist, list);
+            vector<int> cpus;
+            for (int cpu : parse_cpulist(list))
+                if (cpu < CPU_SETSIZE and CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+            if (not cpus.empty())
+                found.push_back({node, cpus});
+        }
+        closedir(dir);
+    }
+    sort(found.begin(), found.end());
+
+    vector< vector<int> > nodes;
+    for (auto& node : found)
+        nodes.push_back(node.second);
+    if (nodes.empty())
+    {
+        // no NUMA information, treat as one node
+        nodes.resize(1);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &allowed))
+                nodes[0].push_back(cpu);
+    }
+    return nodes;
+}
+
+CpuAffinity::CpuAffinity(const string& policy)
+{
+    if (policy.empty())
+        return;
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed))
+        throw runtime_error("cannot get CPU affinity: " + string(strerror(errno)));
+    vector< vector<int> > nodes = get_nodes(allowed);
+
+    if (policy == "core")
+    {
+        for (auto& node : nodes)
+            for (int cpu : node)
+                thread_cpus.push_back({cpu});
+    }
+    else if (policy == "node")
+        thread_cpus = nodes;
+    else
+    {
+        stringstream ss(policy);
+        string list;
+        while (getline(ss, list, ':'))
+        {
+            thread_cpus.push_back(parse_cpulist(list));
+            if (thread_cpus.back().empty())
+                throw runtime_error("empty CPU list in affinity: " + policy);
+        }
+    }
+
+    cerr << "Using " << nodes.size() << " NUMA node(s) for thread placement"
+            << endl;
+}
+
+void CpuAffinity::pin(int thread_num) const
+{
+    if (not active())
+        return;
+
+    const vector<int>& cpus = thread_cpus[thread_num % thread_cpus.size()];
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    cerr << "Pinning thread " << thread_num << " to CPU(s)";
+    for (int cpu : cpus)
+    {
+        if (cpu >= CPU_SETSIZE)
+            throw runtime_error("CPU number too large: " + to_string(cpu));
+        CPU_SET(cpu, &mask);
+        cerr << " " << cpu;
+    }
+    cerr << endl;
+
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    if (ret)
+        throw runtime_error("cannot pin thread " + to_string(thread_num)
+                + ": " + strerror(ret));
+}
@@ -0,0 +1,43 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * Affinity.h
+ *
+ */
+
+#ifndef TOOLS_AFFINITY_H_
+#define TOOLS_AFFINITY_H_
+
+#include <sched.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*
+ * Placement of online threads on CPUs.
+ * Policies:
+ *   ""      no pinning
+ *   core    one CPU per thread, filling NUMA nodes in order
+ *   node    all CPUs of one NUMA node per thread, round-robin over nodes
+ *   <list>  explicit CPU lists per thread separated by ':', e.g. 0-7:8-15
+ * Threads beyond the given lists wrap around.
+ */
+class CpuAffinity
+{
+    vector< vector<int> > thread_cpus;
+
+    static vector<int> parse_cpulist(const string& list);
+    static vector< vector<int> > get_nodes(const cpu_set_t& allowed);
+
+public:
+    CpuAffinity() {}
+    CpuAffinity(const string& policy);
+
+    bool active() const { return not thread_cpus.empty(); }
+
+    // Pin the calling thread. Threads it creates inherit the mask,
+    // and memory it touches first is allocated on the local node.
+    void pin(int thread_num) const;
+};
+
+#endif /* TOOLS_AFFINITY_H_ */
@@ -0,0 +1,91 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * OctetPool.cpp
+ *
+ */
+
+#include "Tools/OctetPool.h"
+
+#include <algorithm>
+
+// plain types stay valid while thread-local objects are destroyed
+static thread_local OctetPool* local_pool = 0;
+static thread_local bool pool_gone = false;
+
+struct OctetPoolOwner
+{
+    ~OctetPoolOwner()
+    {
+        delete local_pool;
+        local_pool = 0;
+        pool_gone = true;
+    }
+};
+
+static thread_local OctetPoolOwner pool_owner;
+
+OctetPool::~OctetPool()
+{
+    for (auto& free_list : free_lists)
+        for (auto buffer : free_list)
+            delete[] buffer;
+}
+
+OctetPool* OctetPool::local()
+{
+    if (local_pool == 0 and not pool_gone)
+    {
+        // register for destruction at thread exit
+        (void) &pool_owner;
+        local_pool = new OctetPool;
+    }
+    return local_pool;
+}
+
+// smallest c with 2^c >= size
+static int size_class(size_t size)
+{
+    int res = 0;
+    while (res < 64 and (size_t(1) << res) < size)
+        res++;
+    return res;
+}
+
+size_t OctetPool::capacity(size_t size)
+{
+    int c = max(size_class(size), MIN_CLASS);
+    if (c > MAX_CLASS)
+        return size;
+    return size_t(1) << c;
+}
+
+octet* OctetPool::get(size_t size)
+{
+    size = capacity(size);
+    int c = size_class(size);
+    OctetPool* pool = local();
+    if (pool and c <= MAX_CLASS and not pool->free_lists[c].empty())
+    {
+        octet* res = pool->free_lists[c].back();
+        pool->free_lists[c].pop_back();
+        pool->cached -= size;
+        return res;
+    }
+    return new octet[size];
+}
+
+void OctetPool::put(octet* buffer, size_t size)
+{
+    int c = size_class(size);
+    OctetPool* pool = local();
+    if (pool and c >= MIN_CLASS and c <= MAX_CLASS and size == (size_t(1) << c)
+            and pool->free_lists[c].size() < MAX_FREE
+            and pool->cached + size <= MAX_CACHED)
+    {
+        pool->free_lists[c].push_back(buffer);
+        pool->cached += size;
+    }
+    else
+        delete[] buffer;
+}
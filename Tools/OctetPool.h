@@ -0,0 +1,51 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * OctetPool.h
+ *
+ */
+
+#ifndef TOOLS_OCTETPOOL_H_
+#define TOOLS_OCTETPOOL_H_
+
+#include <stddef.h>
+#include <vector>
+using namespace std;
+
+typedef unsigned char octet;
+
+/*
+ * Per-thread free lists of buffers with power-of-two sizes, so that
+ * octetStreams of recurring sizes do not go through the allocator
+ * every round. A buffer can be returned by any thread. Buffers
+ * outside the size classes are allocated precisely and not kept.
+ */
+class OctetPool
+{
+    static const int MIN_CLASS = 6;
+    static const int MAX_CLASS = 26;
+    // per thread and size class
+    static const size_t MAX_FREE = 16;
+    // per thread in total
+    static const size_t MAX_CACHED = 1 << 28;
+
+    vector<octet*> free_lists[MAX_CLASS + 1];
+    size_t cached;
+
+    OctetPool() : cached(0) {}
+    ~OctetPool();
+
+    static OctetPool* local();
+
+    friend struct OctetPoolOwner;
+
+public:
+    // Size that get() will allocate for this request
+    static size_t capacity(size_t size);
+    // Buffer of capacity(size) octets
+    static octet* get(size_t size);
+    // size must be the capacity of the buffer
+    static void put(octet* buffer, size_t size);
+};
+
+#endif /* TOOLS_OCTETPOOL_H_ */
@@ -7,6 +7,7 @@
 
 #include <Tools/OfflineMachineBase.h>
 #include "Tools/int.h"
+#include "Tools/ShmPipe.h"
 
 #include <string>
 using namespace std;
@@ -71,6 +72,15 @@ void OfflineMachineBase::parse_options(int argc, const char** argv)
         "-o", // Flag token.
         "--output" // Flag token.
     );
+    opt.add(
+        "", // Default.
+        0, // Required?
+        0, // Number of args expected.
+        0, // Delimiter if expecting multiple args.
+        "Stream verified tuples to an online process on the same host through shared memory (implies -o).", // Help description.
+        "-sp", // Flag token.
+        "--shm-pipe" // Flag token.
+    );
 
     opt.parse(argc, argv);
     if (!opt.isSet("-p"))
@@ -85,7 +95,8 @@ void OfflineMachineBase::parse_options(int argc, const char** argv)
     opt.get("-N")->getInt(nplayers);
     opt.get("-x")->getInt(nthreads);
     opt.get("-n")->getLongLong(ntriples);
-    output = opt.get("-o")->isSet;
+    ShmPipeBuf::enabled = opt.get("-sp")->isSet;
+    output = opt.get("-o")->isSet or ShmPipeBuf::enabled;
 
     nTriplesPerThread =  DIV_CEIL(ntriples, nthreads);
 }
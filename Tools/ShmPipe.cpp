@@ -0,0 +1,346 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * ShmPipe.cpp
+ *
+ */
+
+#include "Tools/ShmPipe.h"
+#include "Exceptions/Exceptions.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+#define SHM_PIPE_MAGIC 0x50495045
+#define SHM_PIPE_VERSION 3
+
+// spin first because the other side is usually busy on another core
+void ShmPipe::backoff(int& round)
+{
+    if (round < 1000)
+        ;
+    else if (round < 1100)
+        sched_yield();
+    else
+        usleep(100);
+    round++;
+}
+
+string ShmPipe::segment_name(const string& filename)
+{
+    string res = "/spdz-";
+    for (char c : filename)
+        res += c == '/' ? '_' : c;
+    return res;
+}
+
+ShmPipe::ShmPipe(const string& filename, int fd, bool producer) :
+        header(0), data(0), mapped_size(0), name(segment_name(filename)),
+        filename(filename), producer(producer)
+{
+    ShmPipeHeader* tmp = (ShmPipeHeader*) mmap(0, sizeof(ShmPipeHeader),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (tmp == MAP_FAILED)
+        throw runtime_error("cannot map " + name);
+    size_t capacity = tmp->capacity;
+    munmap(tmp, sizeof(ShmPipeHeader));
+    mapped_size = sizeof(ShmPipeHeader) + capacity;
+    void* res = mmap(0, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (res == MAP_FAILED)
+        throw runtime_error("cannot map " + name);
+    header = (ShmPipeHeader*) res;
+    data = (char*) res + sizeof(ShmPipeHeader);
+}
+
+ShmPipe* ShmPipe::create(const string& filename, size_t capacity,
+        bool keep_unread)
+{
+    string name = segment_name(filename);
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return 0;
+    if (ftruncate(fd, sizeof(ShmPipeHeader) + capacity) < 0)
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return 0;
+    }
+    ShmPipeHeader* header = (ShmPipeHeader*) mmap(0, sizeof(ShmPipeHeader),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED)
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return 0;
+    }
+    header->capacity = capacity;
+    header->head = 0;
+    header->tail = 0;
+    header->producer_closed = 0;
+    header->consumer_state = CONSUMER_NONE;
+    header->keep_unread = keep_unread;
+    header->drained = 0;
+    header->version = SHM_PIPE_VERSION;
+    atomic_thread_fence(memory_order_release);
+    header->magic = SHM_PIPE_MAGIC;
+    munmap(header, sizeof(ShmPipeHeader));
+    ShmPipe* res = new ShmPipe(filename, fd, true);
+    ::close(fd);
+    return res;
+}
+
+ShmPipe* ShmPipe::attach(const string& filename)
+{
+    string name = segment_name(filename);
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return 0;
+    ShmPipe* res = new ShmPipe(filename, fd, false);
+    ::close(fd);
+    int expected = CONSUMER_NONE;
+    if (res->header->magic != SHM_PIPE_MAGIC
+            or res->header->version != SHM_PIPE_VERSION
+            or not res->header->consumer_state.compare_exchange_strong(
+                    expected, CONSUMER_ATTACHED))
+    {
+        // leave the segment to its owners
+        munmap(res->header, res->mapped_size);
+        res->header = 0;
+        delete res;
+        return 0;
+    }
+    return res;
+}
+
+ShmPipe::~ShmPipe()
+{
+    if (header == 0)
+        return;
+    if (producer)
+        close();
+    else
+    {
+        // unblock the producer and prevent reuse
+        header->consumer_state = CONSUMER_DETACHED;
+        // pairs with close()
+        if (header->producer_closed)
+            drain();
+        shm_unlink(name.c_str());
+    }
+    munmap(header, mapped_size);
+}
+
+size_t ShmPipe::write_some(const char* buffer, size_t size)
+{
+    uint64_t capacity = header->capacity;
+    uint64_t head = header->head.load(memory_order_relaxed);
+    size_t done = 0;
+    while (done < size)
+    {
+        uint64_t space = capacity
+                - (head - header->tail.load(memory_order_acquire));
+        if (space == 0)
+            break;
+        size_t pos = head % capacity;
+        size_t n = min(min((uint64_t) size - done, space), capacity - pos);
+        memcpy(data + pos, buffer + done, n);
+        done += n;
+        head += n;
+        header->head.store(head, memory_order_release);
+    }
+    return done;
+}
+
+size_t ShmPipe::read_some(char* buffer, size_t size)
+{
+    uint64_t capacity = header->capacity;
+    uint64_t tail = header->tail.load(memory_order_relaxed);
+    size_t done = 0;
+    while (done < size)
+    {
+        uint64_t available = header->head.load(memory_order_acquire) - tail;
+        if (available == 0)
+            break;
+        size_t pos = tail % capacity;
+        size_t n = min(min((uint64_t) size - done, available), capacity - pos);
+        if (buffer)
+            memcpy(buffer + done, data + pos, n);
+        done += n;
+        tail += n;
+        header->tail.store(tail, memory_order_release);
+    }
+    return done;
+}
+
+bool ShmPipe::consumer_gone()
+{
+    // the tail is final after this
+    return header->consumer_state == CONSUMER_DETACHED;
+}
+
+bool ShmPipe::producer_done()
+{
+    // check head again after seeing the flag
+    return header->producer_closed.load(memory_order_acquire)
+            and header->head.load(memory_order_acquire)
+                    == header->tail.load(memory_order_relaxed);
+}
+
+size_t ShmPipe::write(const char* buffer, size_t size)
+{
+    size_t done = 0;
+    int round = 0;
+    while (done < size and not consumer_gone())
+    {
+        size_t n = write_some(buffer + done, size - done);
+        if (n == 0)
+            backoff(round);
+        else
+            round = 0;
+        done += n;
+    }
+    return done;
+}
+
+size_t ShmPipe::read(char* buffer, size_t size)
+{
+    size_t done = 0;
+    int round = 0;
+    while (done < size)
+    {
+        size_t n = read_some(buffer ? buffer + done : 0, size - done);
+        if (n == 0)
+        {
+            if (producer_done())
+                break;
+            backoff(round);
+        }
+        else
+            round = 0;
+        done += n;
+    }
+    return done;
+}
+
+size_t ShmPipe::skip(size_t size)
+{
+    return read(0, size);
+}
+
+void ShmPipe::close()
+{
+    header->producer_closed = 1;
+    // pairs with the consumer's destructor
+    if (consumer_gone())
+        drain();
+}
+
+void ShmPipe::drain()
+{
+    if (not header->keep_unread or header->drained.exchange(1))
+        return;
+    ofstream outf(filename.c_str(), ios::out | ios::binary | ios::app);
+    char buffer[1 << 16];
+    size_t n;
+    while ((n = read_some(buffer, sizeof(buffer))) > 0)
+        outf.write(buffer, n);
+    // also called from destructors
+    if (outf.fail())
+        cerr << "Cannot append unread data from shared memory to "
+                << filename << endl;
+}
+
+
+bool ShmPipeBuf::enabled = false;
+
+static mutex shm_pipe_lock;
+static map<string, ShmPipeBuf*> shm_pipe_bufs;
+
+void ShmPipeBuf::redirect(ofstream& outf, const string& filename)
+{
+    lock_guard<mutex> lock(shm_pipe_lock);
+    ShmPipeBuf*& buf = shm_pipe_bufs[filename];
+    if (buf == 0)
+    {
+        if (shm_pipe_bufs.size() == 1)
+            atexit(close_all);
+        buf = new ShmPipeBuf(filename);
+    }
+    if (outf.is_open())
+        outf.close();
+    static_cast<ostream&>(outf).rdbuf(buf);
+}
+
+void ShmPipeBuf::close_all()
+{
+    lock_guard<mutex> lock(shm_pipe_lock);
+    for (auto& x : shm_pipe_bufs)
+        delete x.second;
+    shm_pipe_bufs.clear();
+}
+
+ShmPipeBuf::ShmPipeBuf(const string& filename) :
+        filename(filename)
+{
+    pipe = ShmPipe::create(filename, ShmPipe::DEFAULT_CAPACITY, true);
+    if (pipe)
+        cerr << "Streaming " << filename << " through shared memory" << endl;
+    else
+        cerr << "Cannot create shared memory for " << filename
+                << ", writing to file" << endl;
+}
+
+ShmPipeBuf::~ShmPipeBuf()
+{
+    delete pipe;
+}
+
+streamsize ShmPipeBuf::xsputn(const char* s, streamsize n)
+{
+    streamsize done = 0;
+    if (pipe)
+        done = pipe->write(s, n);
+    if (done < n)
+    {
+        if (not fallback.is_open())
+        {
+            if (pipe)
+            {
+                cerr << "Online consumer of " << filename
+                        << " has gone, appending to file" << endl;
+                pipe->drain();
+            }
+            fallback.open(filename.c_str(), ios::out | ios::binary | ios::app);
+            if (fallback.fail())
+                throw file_error(filename);
+        }
+        fallback.write(s + done, n - done);
+        if (fallback.fail())
+            return done;
+        done = n;
+    }
+    return done;
+}
+
+int ShmPipeBuf::overflow(int c)
+{
+    if (c == traits_type::eof())
+        return traits_type::not_eof(c);
+    char x = c;
+    return xsputn(&x, 1) == 1 ? c : traits_type::eof();
+}
+
+int ShmPipeBuf::sync()
+{
+    if (fallback.is_open())
+        fallback.flush();
+    return 0;
+}
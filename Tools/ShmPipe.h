@@ -0,0 +1,134 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * ShmPipe.h
+ *
+ */
+
+#ifndef TOOLS_SHMPIPE_H_
+#define TOOLS_SHMPIPE_H_
+
+#include <atomic>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <stdint.h>
+using namespace std;
+
+// Layout at the start of the segment, followed by the ring data.
+// Producer and consumer counters live on separate cache lines.
+struct ShmPipeHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    char pad0[48];
+    // bytes written so far
+    atomic<uint64_t> head;
+    char pad1[56];
+    // bytes read so far
+    atomic<uint64_t> tail;
+    char pad2[56];
+    atomic<int> producer_closed;
+    atomic<int> consumer_state;
+    // whether unread data goes to the file, set by the producer
+    int keep_unread;
+    // set by whoever moves the unread data to the file
+    atomic<int> drained;
+};
+
+/*
+ * Single-producer single-consumer byte ring in POSIX shared memory,
+ * named after the preprocessing file it replaces.
+ * An offline process creates the segment and streams verified tuples into it;
+ * the online process attaches when setting up the corresponding buffer.
+ * The producer blocks while the ring is full and falls back to
+ * appending to the file once the consumer has detached.
+ * With keep_unread, data not read by the consumer goes to the file
+ * first, written by the producer or, if the latter has closed already,
+ * by the consumer. Otherwise the file is never touched.
+ */
+class ShmPipe
+{
+    ShmPipeHeader* header;
+    char* data;
+    size_t mapped_size;
+    string name;
+    string filename;
+    bool producer;
+
+    ShmPipe(const string& filename, int fd, bool producer);
+
+public:
+    enum
+    {
+        CONSUMER_NONE, CONSUMER_ATTACHED, CONSUMER_DETACHED
+    };
+
+    static const size_t DEFAULT_CAPACITY = 1 << 22;
+
+    static string segment_name(const string& filename);
+    // Waiting for the other side, start with round = 0 after progress
+    static void backoff(int& round);
+
+    // Producer side, replaces any stale segment
+    static ShmPipe* create(const string& filename,
+            size_t capacity = DEFAULT_CAPACITY, bool keep_unread = false);
+    // Consumer side, 0 if there is no producer or it already has a consumer
+    static ShmPipe* attach(const string& filename);
+
+    ~ShmPipe();
+
+    // Blocks while full, returns less than size if the consumer has gone
+    size_t write(const char* buffer, size_t size);
+    // Blocks while empty, returns less than size if the producer has closed
+    size_t read(char* buffer, size_t size);
+    // Discard up to size bytes, same blocking as read()
+    size_t skip(size_t size);
+
+    // As much as possible without waiting
+    size_t write_some(const char* buffer, size_t size);
+    size_t read_some(char* buffer, size_t size);
+    bool consumer_gone();
+    // closed and everything read
+    bool producer_done();
+    // Append unread data to the file with keep_unread once both sides
+    // agree that it will not be read from the ring, only one side does
+    void drain();
+
+    void close();
+
+    uint64_t bytes_read() { return header->tail.load(); }
+};
+
+/*
+ * Output stream buffer writing to a pipe, or to the file
+ * after the consumer is gone. Unbuffered so that every tuple becomes
+ * visible immediately.
+ */
+class ShmPipeBuf : public streambuf
+{
+    ShmPipe* pipe;
+    string filename;
+    ofstream fallback;
+
+protected:
+    streamsize xsputn(const char* s, streamsize n);
+    int overflow(int c);
+    int sync();
+
+public:
+    // Set by offline tools to stream final tuples to the online phase
+    static bool enabled;
+
+    // Redirect a stream for a preprocessing file to its pipe,
+    // creating the latter on first use
+    static void redirect(ofstream& outf, const string& filename);
+    // Mark all pipes as complete
+    static void close_all();
+
+    ShmPipeBuf(const string& filename);
+    ~ShmPipeBuf();
+};
+
+#endif /* TOOLS_SHMPIPE_H_ */
@@ -0,0 +1,145 @@
+// (C) 2018 University of Bristol. See License.txt
+
+/*
+ * SpscQueue.h
+ *
+ */
+
+#ifndef TOOLS_SPSCQUEUE_H_
+#define TOOLS_SPSCQUEUE_H_
+
+#include <emmintrin.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+#include <vector>
+using namespace std;
+
+/*
+ * Bounded lock-free queue for exactly one producing and one consuming
+ * thread, with the same interface as WaitQueue. Waiting threads spin
+ * first if there are several CPUs because the other side usually
+ * answers within microseconds, and only park on a condition variable
+ * after that. The spinning time adapts to how often it was enough
+ * before. push() waits while the queue is full. After stop(), pop() returns false and push()
+ * drops values.
+ */
+template<class T, size_t N = 256>
+class SpscQueue
+{
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+    static const int MIN_SPIN = 1 << 6;
+    static const int MAX_SPIN = 1 << 14;
+
+    vector<T> slots;
+
+    // separate cache lines for the two sides
+    char pad0[64];
+    atomic<size_t> head;
+    int producer_spin;
+    char pad1[64];
+    atomic<size_t> tail;
+    int consumer_spin;
+    char pad2[64];
+
+    atomic<bool> running;
+    atomic<int> n_parked;
+    mutex lock;
+    condition_variable cv;
+
+    // prevent copying
+    SpscQueue(const SpscQueue& other);
+
+    template<class F>
+    void wait_for(F ready, int& spin)
+    {
+        // spinning only delays the other side on a single CPU
+        static const bool multi_core = thread::hardware_concurrency() > 1;
+        for (int i = 0; multi_core and i < spin; i++)
+        {
+            if (ready())
+            {
+                spin = min(2 * spin, int(MAX_SPIN));
+                return;
+            }
+            _mm_pause();
+        }
+        spin = max(spin / 2, int(MIN_SPIN));
+
+        unique_lock<mutex> l(lock);
+        n_parked++;
+        // pairs with the fence in wake()
+        atomic_thread_fence(memory_order_seq_cst);
+        while (not ready())
+            cv.wait(l);
+        n_parked--;
+    }
+
+    void wake()
+    {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (n_parked.load(memory_order_relaxed))
+        {
+            lock_guard<mutex> l(lock);
+            cv.notify_all();
+        }
+    }
+
+    template<class U>
+    void push_value(U&& value)
+    {
+        size_t h = head.load(memory_order_relaxed);
+        wait_for([&]()
+        {   return h - tail.load(memory_order_acquire) < N
+                    or not running.load(memory_order_acquire);}, producer_spin);
+        if (not running.load(memory_order_acquire))
+            return;
+        slots[h % N] = forward<U>(value);
+        head.store(h + 1, memory_order_release);
+        wake();
+    }
+
+public:
+    SpscQueue() :
+            slots(N), head(0), producer_spin(MAX_SPIN), tail(0),
+            consumer_spin(MAX_SPIN), running(true), n_parked(0)
+    {
+    }
+
+    void push(const T& value)
+    {
+        push_value(value);
+    }
+
+    void push(T&& value)
+    {
+        push_value(move(value));
+    }
+
+    bool pop(T& value)
+    {
+        size_t t = tail.load(memory_order_relaxed);
+        wait_for([&]()
+        {   return head.load(memory_order_acquire) != t
+                    or not running.load(memory_order_acquire);}, consumer_spin);
+        if (not running.load(memory_order_acquire))
+            return false;
+        value = move(slots[t % N]);
+        tail.store(t + 1, memory_order_release);
+        wake();
+        return true;
+    }
+
+    void stop()
+    {
+        running.store(false, memory_order_release);
+        atomic_thread_fence(memory_order_seq_cst);
+        lock_guard<mutex> l(lock);
+        cv.notify_all();
+    }
+};
+
+#endif /* TOOLS_SPSCQUEUE_H_ */
@@ -10,6 +10,7 @@
 
 #include <pthread.h>
 #include <deque>
+#include <utility>
 using namespace std;
 
 template<class T>
@@ -65,14 +66,22 @@ public:
         unlock();
     }
 
+    void push(T&& value)
+    {
+        lock();
+        queue.push_back(move(value));
+        signal();
+        unlock();
+    }
+
     bool pop(T& value)
     {
         lock();
-        if (running and queue.size() == 0)
+        while (running and queue.size() == 0)
             wait();
         if (running)
         {
-            value = queue.front();
+            value = move(queue.front());
             queue.pop_front();
         }
         unlock();
@@ -16,7 +16,7 @@
 void octetStream::clear()
 {
     if (data)
-        delete[] data;
+        OctetPool::put(data, mxlen);
     data = 0;
     len = mxlen = ptr = 0;
 }
@@ -26,9 +26,9 @@ void octetStream::assign(const octetStream& os)
   if (os.len>=mxlen)
     {
       if (data)
-        delete[] data;
-      mxlen=os.mxlen;  
-      data=new octet[mxlen];
+        OctetPool::put(data, mxlen);
+      mxlen=OctetPool::capacity(os.len);
+      data=OctetPool::get(mxlen);
     }
   len=os.len;
   memcpy(data,os.data,len*sizeof(octet));
@@ -48,16 +48,16 @@ void octetStream::swap(octetStream& os)
 
 octetStream::octetStream(size_t maxlen)
 {
-  mxlen=maxlen; len=0; ptr=0;
-  data=new octet[mxlen];
+  mxlen=OctetPool::capacity(maxlen); len=0; ptr=0;
+  data=OctetPool::get(mxlen);
 }
 
 
 octetStream::octetStream(const octetStream& os)
 {
-  mxlen=os.mxlen;
+  mxlen=OctetPool::capacity(os.len);
   len=os.len;
-  data=new octet[mxlen];
+  data=OctetPool::get(mxlen);
   memcpy(data,os.data,len*sizeof(octet));
   ptr=os.ptr;
 }
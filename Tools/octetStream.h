@@ -21,6 +21,7 @@
 
 #include "Networking/data.h"
 #include "Networking/sockets.h"
+#include "Tools/OctetPool.h"
 
 #include <string.h>
 #include <vector>
@@ -41,6 +42,7 @@ class octetStream
   public:
 
   void resize(size_t l);
+  // capacity rounded to the size classes of OctetPool
   void resize_precise(size_t l);
   void clear();
 
@@ -50,11 +52,18 @@ class octetStream
   octetStream() : len(0), mxlen(0), ptr(0), data(0) {}
   octetStream(size_t maxlen);
   octetStream(const octetStream& os);
+  octetStream(octetStream&& os) noexcept :
+    len(os.len), mxlen(os.mxlen), ptr(os.ptr), data(os.data)
+    { os.len = os.mxlen = os.ptr = 0; os.data = 0; }
   octetStream& operator=(const octetStream& os)
     { if (this!=&os) { assign(os); }
       return *this;
     }
-  ~octetStream() { if(data) delete[] data; }
+  octetStream& operator=(octetStream&& os) noexcept
+    { if (this!=&os) { clear(); swap(os); }
+      return *this;
+    }
+  ~octetStream() { if(data) OctetPool::put(data, mxlen); }
   
   size_t get_ptr() const     { return ptr; }
   size_t get_length() const  { return len; }
@@ -88,6 +97,8 @@ class octetStream
 
   // Append with no padding for decoding
   void append(const octet* x,const size_t l);
+  // Return pointer to l octets at the end and advance write head
+  octet* append(size_t l) { if (len+l>mxlen) resize(len+l); len+=l; return data+len-l; }
   // Read l octets, with no padding for decoding
   void consume(octet* x,const size_t l);
   // Return pointer to next l octets and advance pointer
@@ -164,14 +175,15 @@ inline void octetStream::resize(size_t l)
 
 inline void octetStream::resize_precise(size_t l)
 {
+  l=OctetPool::capacity(l);
   if (l == mxlen)
     return;
 
-  octet* nd=new octet[l];
+  octet* nd=OctetPool::get(l);
   if (data)
     {
       memcpy(nd, data, min(len, l) * sizeof(octet));
-      delete[] data;
+      OctetPool::put(data, mxlen);
     }
   data=nd;
   mxlen=l;
@@ -196,8 +208,15 @@ inline void octetStream::consume(octet* x,const size_t l)
 
 inline void octetStream::Send(int socket_num) const
 {
-  send(socket_num,len,LENGTH_SIZE);
-  send(socket_num,data,len);
+  // length and data in one system call
+  octet blen[LENGTH_SIZE];
+  encode_length(blen,len,LENGTH_SIZE);
+  struct iovec iov[2];
+  iov[0].iov_base = blen;
+  iov[0].iov_len = LENGTH_SIZE;
+  iov[1].iov_base = data;
+  iov[1].iov_len = len;
+  send(socket_num,iov,len ? 2 : 1);
 }
 
 
@@ -206,7 +225,9 @@ inline void octetStream::Receive(int socket_num)
   size_t nlen=0;
   receive(socket_num,nlen,LENGTH_SIZE);
   len=0;
-  resize_precise(nlen);
+  // keep the buffer if it is large enough
+  if (nlen>mxlen)
+    resize_precise(nlen);
   len=nlen;
 
   receive(socket_num,data,len);